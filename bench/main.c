@@ -0,0 +1,501 @@
+//Author                 : Seityagiya Terlekchi
+//Contacts               : seityaya@ukr.net
+//Creation Date          : 2022.12
+//License Link           : https://spdx.org/licenses/LGPL-2.1-or-later.html
+//SPDX-License-Identifier: LGPL-2.1-or-later
+//Copyright © 2022-2023 Seityagiya Terlekchi. All rights reserved.
+
+#include "stdio.h"
+#include "inttypes.h"
+#include "stddef.h"
+#include "stdlib.h"
+#include "string.h"
+#include "time.h"
+
+#include "yaya_memory.h"
+
+static double bench_time(void)
+{
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return (double)(ts.tv_sec) + (double)(ts.tv_nsec) * 1e-9;
+}
+
+static void bench_show(const char *name, double sec, size_t ops)
+{
+    printf("%-32s: %10.2f ns/op\n", name, sec * 1e9 / (double)(ops));
+    fflush(stdout);
+}
+
+/*Псевдослучайные размеры малых объектов 16..256 байт*/
+static size_t bench_size(size_t i)
+{
+    return 16 + ((i * 2654435761U) >> 7) % 241;
+}
+
+void bench_slab() {
+    printf("bench_slab\n");
+
+    const size_t count_live  = 4096;
+    const size_t count_round = 512;
+    void **ptr = calloc(count_live, sizeof(void*));
+
+    /*Перемешанное выделение и освобождение через memory_new/memory_del*/
+    double beg = bench_time();
+    for(size_t r = 0; r < count_round; r++){
+        for(size_t i = 0; i < count_live; i++){
+            mem_new(&mem_stats, &ptr[i], NULL, bench_size(i + r), sizeof(char));
+        }
+        for(size_t i = 0; i < count_live; i++){
+            mem_del(&mem_stats, &ptr[(i * 7) % count_live]);
+        }
+    }
+    bench_show("memory_new + memory_del", bench_time() - beg, count_live * count_round);
+
+    /*Тот же шаблон напрямую через malloc/free*/
+    beg = bench_time();
+    for(size_t r = 0; r < count_round; r++){
+        for(size_t i = 0; i < count_live; i++){
+            ptr[i] = malloc(bench_size(i + r));
+        }
+        for(size_t i = 0; i < count_live; i++){
+            free(ptr[(i * 7) % count_live]);
+        }
+    }
+    bench_show("malloc + free", bench_time() - beg, count_live * count_round);
+
+    free(ptr);
+    printf("\n");
+    fflush(stdout);
+}
+
+/*Прежнее затирание побайтно через volatile*/
+static void bench_wipe_byte(void *ptr, size_t len)
+{
+    volatile size_t  size = len;
+    volatile uint8_t *p   = ptr;
+    while (size--){
+        *p++ = 0;
+    }
+}
+
+void bench_wipe() {
+    printf("bench_wipe\n");
+
+    const size_t count_size = 4;
+    const size_t size[4] = {4096, 262144, 4194304, 67108864};
+    char name[64] = {0};
+
+    for(size_t s = 0; s < count_size; s++){
+        void *ptr = NULL;
+        mem_new(&mem_stats, &ptr, NULL, size[s], sizeof(char));
+        memset(ptr, 0x11, size[s]);
+
+        size_t round = (size_t)(1) << 28;
+        round = (round / size[s] > 0) ? round / size[s] : 1;
+
+        double beg = bench_time();
+        for(size_t r = 0; r < round; r++){
+            mem_zero(ptr);
+        }
+        snprintf(name, sizeof(name), "memory_zero   %9zu", size[s]);
+        bench_show(name, bench_time() - beg, round * size[s]);
+
+        beg = bench_time();
+        for(size_t r = 0; r < round; r++){
+            bench_wipe_byte(ptr, size[s]);
+        }
+        snprintf(name, sizeof(name), "volatile loop %9zu", size[s]);
+        bench_show(name, bench_time() - beg, round * size[s]);
+
+        mem_del(&mem_stats, &ptr);
+    }
+
+    printf("(op = byte)\n\n");
+    fflush(stdout);
+}
+
+void bench_grow() {
+    printf("bench_grow\n");
+
+    const size_t count_mas = 1000000;
+    uint32_t *mas = NULL;
+
+    /*Добавление по одному элементу через memory_new*/
+    double beg = bench_time();
+    for(size_t i = 0; i < count_mas; i++){
+        mem_new(&mem_stats, &mas, mas, i + 1, sizeof(uint32_t));
+        mas[i] = (uint32_t)(i);
+    }
+    bench_show("memory_new append", bench_time() - beg, count_mas);
+    mem_del(&mem_stats, &mas);
+
+    /*То же после memory_reserve*/
+    beg = bench_time();
+    mem_new(&mem_stats, &mas, NULL, 1, sizeof(uint32_t));
+    mem_reserve(&mem_stats, &mas, count_mas, sizeof(uint32_t));
+    mem_stats_t begin = {0};
+    memory_stats_mark(&mem_stats);
+    memory_stats_snapshot(&mem_stats, &begin);
+    for(size_t i = 0; i < count_mas; i++){
+        mem_new(&mem_stats, &mas, mas, i + 1, sizeof(uint32_t));
+        mas[i] = (uint32_t)(i);
+    }
+    bench_show("memory_reserve + append", bench_time() - beg, count_mas);
+
+    /*Цикл после резерва не должен выделять*/
+    mem_stats_t end = {0};
+    mem_stats_t diff = {0};
+    memory_stats_snapshot(&mem_stats, &end);
+    memory_stats_diff(&begin, &end, &diff);
+    printf("%-32s: %10zu new, %zu B produce\n", "allocations in append", diff.memory_call_new, diff.memory_produce);
+    mem_del(&mem_stats, &mas);
+
+    /*Прямой realloc на каждый элемент*/
+    uint32_t *raw = NULL;
+    beg = bench_time();
+    for(size_t i = 0; i < count_mas; i++){
+        raw = realloc(raw, (i + 1) * sizeof(uint32_t));
+        raw[i] = (uint32_t)(i);
+    }
+    bench_show("realloc append", bench_time() - beg, count_mas);
+    free(raw);
+
+    printf("\n");
+    fflush(stdout);
+}
+
+void bench_batch() {
+    printf("bench_batch\n");
+
+    const size_t count_ptr   = 256;
+    const size_t count_round = 8192;
+    void *ptr[256] = {0};
+
+    /*Поштучно*/
+    double beg = bench_time();
+    for(size_t r = 0; r < count_round; r++){
+        for(size_t i = 0; i < count_ptr; i++){
+            mem_new(&mem_stats, &ptr[i], NULL, 48, sizeof(char));
+        }
+        for(size_t i = 0; i < count_ptr; i++){
+            mem_del(&mem_stats, &ptr[i]);
+        }
+    }
+    bench_show("memory_new + memory_del", bench_time() - beg, count_ptr * count_round);
+
+    /*Пачкой*/
+    beg = bench_time();
+    for(size_t r = 0; r < count_round; r++){
+        mem_new_batch(&mem_stats, ptr, count_ptr, 48);
+        mem_del_batch(&mem_stats, ptr, count_ptr);
+    }
+    bench_show("memory_new_batch + del_batch", bench_time() - beg, count_ptr * count_round);
+
+    printf("\n");
+    fflush(stdout);
+}
+
+void bench_info() {
+    printf("bench_info\n");
+
+    const size_t count_live  = 65536;
+    const size_t count_round = 64;
+    void **ptr = calloc(count_live, sizeof(void*));
+
+    /*Объекты по 32 байта, издержки заголовка видны в статистике*/
+    double beg = bench_time();
+    for(size_t r = 0; r < count_round; r++){
+        for(size_t i = 0; i < count_live; i++){
+            mem_new(&mem_stats, &ptr[i], NULL, 32, sizeof(char));
+        }
+        for(size_t i = 0; i < count_live; i++){
+            mem_del(&mem_stats, &ptr[(i * 7) % count_live]);
+        }
+    }
+    bench_show("memory_new + memory_del 32", bench_time() - beg, count_live * count_round);
+
+    /*Обход живых объектов*/
+    for(size_t i = 0; i < count_live; i++){
+        mem_new(&mem_stats, &ptr[i], NULL, 32, sizeof(char));
+    }
+    mem_stats_t snapshot = {0};
+    memory_stats_snapshot(&mem_stats, &snapshot);
+
+    size_t sum = 0;
+    beg = bench_time();
+    for(size_t r = 0; r < count_round; r++){
+        for(size_t i = 0; i < count_live; i++){
+            sum += memory_size(ptr[i]) + ((uint8_t*)(ptr[i]))[r % 32];
+        }
+    }
+    bench_show("memory_size + touch", bench_time() - beg, count_live * count_round);
+
+    for(size_t i = 0; i < count_live; i++){
+        mem_del(&mem_stats, &ptr[i]);
+    }
+    printf("%-32s: %10zu B (%zu)\n", "header per block", snapshot.memory_header / count_live, sum % 2);
+
+    free(ptr);
+    printf("\n");
+    fflush(stdout);
+}
+
+void bench_huge() {
+    printf("bench_huge\n");
+
+    const size_t count_item  = (size_t)(256) * 1024 * 1024 / sizeof(uint64_t);
+    const size_t count_round = 1U << 24;
+
+    /*Таблица через memory_new, при YAYA_MEMORY_HUGE_USE на больших страницах*/
+    uint64_t *tab = NULL;
+    if(!mem_new(&mem_stats, &tab, NULL, count_item, sizeof(uint64_t))){
+        return;
+    }
+    uint64_t *raw = malloc(count_item * sizeof(uint64_t));
+    if(raw == NULL){
+        mem_del(&mem_stats, &tab);
+        return;
+    }
+    for(size_t i = 0; i < count_item; i++){
+        tab[i] = i;
+        raw[i] = i;
+    }
+
+    /*Случайные чтения по всей таблице, промахи TLB*/
+    uint64_t sum = 0;
+    uint64_t key = 1;
+    double beg = bench_time();
+    for(size_t r = 0; r < count_round; r++){
+        key = key * 6364136223846793005ULL + 1442695040888963407ULL;
+        sum += tab[(key >> 20) % count_item];
+    }
+    bench_show("memory_new random read", bench_time() - beg, count_round);
+
+    key = 1;
+    beg = bench_time();
+    for(size_t r = 0; r < count_round; r++){
+        key = key * 6364136223846793005ULL + 1442695040888963407ULL;
+        sum += raw[(key >> 20) % count_item];
+    }
+    bench_show("malloc random read", bench_time() - beg, count_round);
+
+#if YAYA_MEMORY_HUGE_USE
+    mem_stats_t snapshot = {0};
+    memory_stats_snapshot(&mem_stats, &snapshot);
+    printf("%-32s: %10zu B (%zu)\n", "huge", snapshot.memory_huge, (size_t)(sum % 2));
+#else
+    printf("%-32s: %10zu B (%zu)\n", "huge", (size_t)(0), (size_t)(sum % 2));
+#endif
+
+    free(raw);
+    mem_del(&mem_stats, &tab);
+    printf("\n");
+    fflush(stdout);
+}
+
+static int bench_comp_i32(const void *a, const void *b)
+{
+    int32_t x = *(const int32_t*)(a);
+    int32_t y = *(const int32_t*)(b);
+    return (x > y) - (x < y);
+}
+
+static int bench_comp_f64(const void *a, const void *b)
+{
+    double x = *(const double*)(a);
+    double y = *(const double*)(b);
+    return (x > y) - (x < y);
+}
+
+void bench_sort() {
+    printf("bench_sort\n");
+
+    const size_t count_mas = 1000000;
+    int32_t *mas_i32 = NULL;
+    double  *mas_f64 = NULL;
+    mem_new(&mem_stats, &mas_i32, NULL, count_mas, sizeof(int32_t));
+    mem_new(&mem_stats, &mas_f64, NULL, count_mas, sizeof(double));
+
+    /*Одни и те же случайные данные для каждого способа*/
+    uint64_t key = 1;
+#define BENCH_SORT_FILL()                                                              \
+    key = 1;                                                                           \
+    for(size_t i = 0; i < count_mas; i++){                                             \
+        key = key * 6364136223846793005ULL + 1442695040888963407ULL;                   \
+        mas_i32[i] = (int32_t)(key >> 32);                                             \
+        mas_f64[i] = (double)(int64_t)(key) * 1e-9;                                    \
+    }
+
+    BENCH_SORT_FILL();
+    double beg = bench_time();
+    qsort(mas_i32, count_mas, sizeof(int32_t), bench_comp_i32);
+    bench_show("qsort int32", bench_time() - beg, count_mas);
+
+    BENCH_SORT_FILL();
+    beg = bench_time();
+    mem_sort(mas_i32, count_mas, sizeof(int32_t), bench_comp_i32);
+    bench_show("memory_sort int32", bench_time() - beg, count_mas);
+
+    BENCH_SORT_FILL();
+    beg = bench_time();
+    mem_sort_i32(mas_i32, count_mas);
+    bench_show("memory_sort_i32", bench_time() - beg, count_mas);
+
+    BENCH_SORT_FILL();
+    beg = bench_time();
+    mem_sort_radix(&mem_stats, mas_i32, count_mas, sizeof(int32_t), 0, sizeof(int32_t), MEMORY_KEY_INT);
+    bench_show("memory_sort_radix int32", bench_time() - beg, count_mas);
+
+    BENCH_SORT_FILL();
+    beg = bench_time();
+    qsort(mas_f64, count_mas, sizeof(double), bench_comp_f64);
+    bench_show("qsort double", bench_time() - beg, count_mas);
+
+    BENCH_SORT_FILL();
+    beg = bench_time();
+    mem_sort(mas_f64, count_mas, sizeof(double), bench_comp_f64);
+    bench_show("memory_sort double", bench_time() - beg, count_mas);
+
+    BENCH_SORT_FILL();
+    beg = bench_time();
+    mem_sort_f64(mas_f64, count_mas);
+    bench_show("memory_sort_f64", bench_time() - beg, count_mas);
+
+    BENCH_SORT_FILL();
+    beg = bench_time();
+    mem_sort_radix(&mem_stats, mas_f64, count_mas, sizeof(double), 0, sizeof(double), MEMORY_KEY_FLOAT);
+    bench_show("memory_sort_radix double", bench_time() - beg, count_mas);
+#undef BENCH_SORT_FILL
+
+    mem_del(&mem_stats, &mas_i32);
+    mem_del(&mem_stats, &mas_f64);
+    printf("(op = element)\n\n");
+    fflush(stdout);
+}
+
+void bench_sort_parallel() {
+    printf("bench_sort_parallel\n");
+
+    const size_t count_mas = 16000000;
+    const size_t count_thread = 5;
+    const size_t thread[5] = {1, 2, 4, 8, 16};
+    int32_t *mas = NULL;
+    if(!mem_new(&mem_stats, &mas, NULL, count_mas, sizeof(int32_t))){
+        return;
+    }
+    char name[64] = {0};
+
+    /*Одни и те же данные, меняется только число потоков*/
+    for(size_t t = 0; t < count_thread; t++){
+        uint64_t key = 1;
+        for(size_t i = 0; i < count_mas; i++){
+            key = key * 6364136223846793005ULL + 1442695040888963407ULL;
+            mas[i] = (int32_t)(key >> 32);
+        }
+        double beg = bench_time();
+        mem_sort_parallel(mas, count_mas, sizeof(int32_t), bench_comp_i32, thread[t]);
+        snprintf(name, sizeof(name), "memory_sort_parallel %2zu", thread[t]);
+        bench_show(name, bench_time() - beg, count_mas);
+    }
+
+    mem_del(&mem_stats, &mas);
+    printf("(op = element)\n\n");
+    fflush(stdout);
+}
+
+/*Прежнее перемешивание через rand со вторым проходом*/
+static void bench_shuf_rand(uint32_t *mas, size_t count, unsigned int seed)
+{
+    srand(seed);
+    for(size_t i = 1; i < count; i++){
+        size_t r = ((size_t)(rand()) % (count - i));
+        memory_swap(&mas[i], &mas[r], sizeof(uint32_t));
+    }
+    for(size_t i = 0; i < count; i++){
+        size_t a = ((size_t)(rand()) % count);
+        size_t b = ((size_t)(rand()) % count);
+        memory_swap(&mas[a], &mas[b], sizeof(uint32_t));
+    }
+}
+
+void bench_shuf() {
+    printf("bench_shuf\n");
+
+    const size_t count_size = 2;
+    const size_t size[2] = {100000, 10000000};
+    char name[64] = {0};
+
+    for(size_t s = 0; s < count_size; s++){
+        uint32_t *mas = NULL;
+        if(!mem_new(&mem_stats, &mas, NULL, size[s], sizeof(uint32_t))){
+            return;
+        }
+        for(size_t i = 0; i < size[s]; i++){
+            mas[i] = (uint32_t)(i);
+        }
+
+        double beg = bench_time();
+        bench_shuf_rand(mas, size[s], 1);
+        snprintf(name, sizeof(name), "rand two pass %9zu", size[s]);
+        bench_show(name, bench_time() - beg, size[s]);
+
+        beg = bench_time();
+        mem_shuf(mas, size[s], sizeof(uint32_t), 1);
+        snprintf(name, sizeof(name), "memory_shuf   %9zu", size[s]);
+        bench_show(name, bench_time() - beg, size[s]);
+
+        mem_del(&mem_stats, &mas);
+    }
+
+    printf("(op = element)\n\n");
+    fflush(stdout);
+}
+
+void bench_shuf_parallel() {
+    printf("bench_shuf_parallel\n");
+
+    const size_t count_mas = 50000000;
+    const size_t count_thread = 4;
+    const size_t thread[4] = {1, 2, 4, 8};
+    uint32_t *mas = NULL;
+    if(!mem_new(&mem_stats, &mas, NULL, count_mas, sizeof(uint32_t))){
+        return;
+    }
+    char name[64] = {0};
+    for(size_t i = 0; i < count_mas; i++){
+        mas[i] = (uint32_t)(i);
+    }
+
+    /*Массив много больше кэша последнего уровня*/
+    double beg = bench_time();
+    mem_shuf(mas, count_mas, sizeof(uint32_t), 1);
+    bench_show("memory_shuf", bench_time() - beg, count_mas);
+
+    for(size_t t = 0; t < count_thread; t++){
+        beg = bench_time();
+        mem_shuf_parallel(mas, count_mas, sizeof(uint32_t), 1, thread[t]);
+        snprintf(name, sizeof(name), "memory_shuf_parallel %2zu", thread[t]);
+        bench_show(name, bench_time() - beg, count_mas);
+    }
+
+    mem_del(&mem_stats, &mas);
+    printf("(op = element)\n\n");
+    fflush(stdout);
+}
+
+int main()
+{
+    printf("slab: %d, info: %d, huge: %d, site: %d\n\n", YAYA_MEMORY_SLAB_USE, YAYA_MEMORY_INFO_MODE, YAYA_MEMORY_HUGE_USE, YAYA_MEMORY_SITE_USE);
+    bench_slab();
+    bench_wipe();
+    bench_grow();
+    bench_batch();
+    bench_info();
+    bench_huge();
+    bench_sort();
+    bench_sort_parallel();
+    bench_shuf();
+    bench_shuf_parallel();
+    return 0;
+}
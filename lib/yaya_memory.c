@@ -5,16 +5,159 @@
 //SPDX-License-Identifier: LGPL-2.1-or-later
 //Copyright © 2022-2023 Seityagiya Terlekchi. All rights reserved.
 
+#ifndef _GNU_SOURCE
+#   define _GNU_SOURCE
+#endif /*_GNU_SOURCE*/
+
 #include "yaya_memory.h"
 
 #include "inttypes.h"
 #include "malloc.h"
+#include "stdarg.h"
+#include "stdatomic.h"
 #include "stdio.h"
 #include "stdlib.h"
 #include "string.h"
+#include "time.h"
+
+#if defined(__SSE2__)
+#include "emmintrin.h"
+#endif /*__SSE2__*/
+
+#if YAYA_MEMORY_MMAP_USE
+#include "sys/mman.h"
+#endif /*YAYA_MEMORY_MMAP_USE*/
+
+#if YAYA_MEMORY_MMAP_USE || YAYA_MEMORY_PARALLEL_USE
+#include "unistd.h"
+#endif
+
+#if YAYA_MEMORY_SAMPLE_USE
+#include "execinfo.h"
+#endif /*YAYA_MEMORY_SAMPLE_USE*/
+
+#if YAYA_MEMORY_LATENCY_USE && (defined(__x86_64__) || defined(__i386__))
+#include "x86intrin.h"
+#endif /*YAYA_MEMORY_LATENCY_USE*/
+
+#if YAYA_MEMORY_STATS_USE && YAYA_MEMORY_STATS_REPORT
+#include "errno.h"
+#endif /*YAYA_MEMORY_STATS_REPORT*/
+
+#if (YAYA_MEMORY_STATS_USE && YAYA_MEMORY_STATS_REPORT) || YAYA_MEMORY_QUARANTINE_USE || YAYA_MEMORY_PARALLEL_USE
+#include "pthread.h"
+#endif
+
+/*Номер потока с единицы, выдается при первом обращении*/
+static inline size_t memory_thread_index(void)
+{
+    static atomic_size_t memory_thread_count = 0;
+    static _Thread_local size_t memory_thread_id = 0;
+
+    if(memory_thread_id == 0){
+        memory_thread_id = atomic_fetch_add_explicit(&memory_thread_count, 1, memory_order_relaxed) + 1;
+    }
+    return memory_thread_id;
+}
+
+#if YAYA_MEMORY_STATS_USE && YAYA_MEMORY_STATS_SHARD
+#define MEMORY_CACHE_LINE 64
+
+/*Счетчики одного потока, каждый на своей строке кэша*/
+typedef struct mem_stats_shard_t {
+    alignas(MEMORY_CACHE_LINE) atomic_size_t memory_request;
+    atomic_size_t memory_produce;
+    atomic_size_t memory_release;
+    atomic_size_t memory_call_new;
+    atomic_size_t memory_call_res;
+    atomic_size_t memory_call_del;
+    atomic_size_t memory_header;
+#if YAYA_MEMORY_HUGE_USE
+    atomic_size_t memory_huge;
+#endif
+    atomic_size_t memory_hist_sum;
+    atomic_size_t memory_hist_request[YAYA_MEMORY_STATS_BUCKET];
+    atomic_size_t memory_hist_live[YAYA_MEMORY_STATS_BUCKET];
+}mem_stats_shard_t;
+
+static inline mem_stats_shard_t *memory_stats_shard(mem_stats_t *mem_stats)
+{
+    return &mem_stats->memory_shard[(memory_thread_index() - 1) % YAYA_MEMORY_STATS_SHARD];
+}
+
+/*Статистика не из memory_stats_init (нулевая структура, снимок) без счетчиков потоков, счет в поля как без SHARD*/
+#define MEMORY_STATS_ADD(S, F, V) (((S)->memory_shard != NULL) ?                                                         \
+    (void)(atomic_fetch_add_explicit(&memory_stats_shard(S)->F, (size_t)(V), memory_order_relaxed)) : \
+    (void)((S)->F += (size_t)(V)))
+
+/*Занятое для пика ведется одним общим счетчиком: блок может освободить не тот поток, что выделил,
+  и разность выданного и освобожденного в счетчике потока тогда только растет*/
+#define MEMORY_STATS_LIVE(S, V) (((S)->memory_shard != NULL) ? (void)(__atomic_fetch_add(&(S)->memory_live, (size_t)(V), __ATOMIC_RELAXED)) : (void)(0))
+#else
+#define MEMORY_STATS_ADD(S, F, V) ((S)->F += (size_t)(V))
+#define MEMORY_STATS_LIVE(S, V) ((void)(0))
+#endif /*YAYA_MEMORY_STATS_SHARD*/
+
+#define MEMORY_STATS_PRODUCE(S, V) (MEMORY_STATS_ADD(S, memory_produce, V), MEMORY_STATS_LIVE(S, V))
+#define MEMORY_STATS_RELEASE(S, V) (MEMORY_STATS_ADD(S, memory_release, V), MEMORY_STATS_LIVE(S, -(size_t)(V)))
+
+#if YAYA_MEMORY_STATS_USE && !YAYA_MEMORY_STATS_OFF
+/*Корзина гистограммы по числу значащих бит размера*/
+static inline size_t memory_stats_bucket(size_t size)
+{
+    size_t bucket = (size == 0) ? 0 : (size_t)(64 - __builtin_clzll((unsigned long long)(size)));
+    return (bucket < YAYA_MEMORY_STATS_BUCKET) ? bucket : YAYA_MEMORY_STATS_BUCKET - 1;
+}
+
+/*Перенос живых байт блока из корзины старого запроса в корзину нового*/
+static inline void memory_stats_live(mem_stats_t *mem_stats, size_t old_request, size_t new_request)
+{
+    if(old_request != 0){
+        MEMORY_STATS_ADD(mem_stats, memory_hist_live[memory_stats_bucket(old_request)], -old_request);
+    }
+    if(new_request != 0){
+        MEMORY_STATS_ADD(mem_stats, memory_hist_live[memory_stats_bucket(new_request)], new_request);
+    }
+}
+
+/*Обновление пика занятого после роста*/
+static inline void memory_stats_peak(mem_stats_t *mem_stats)
+{
+#if YAYA_MEMORY_STATS_SHARD
+    if(mem_stats->memory_shard != NULL){
+        size_t live = __atomic_load_n(&mem_stats->memory_live, __ATOMIC_RELAXED);
+        size_t peak = __atomic_load_n(&mem_stats->memory_peak, __ATOMIC_RELAXED);
+        while(live > peak){
+            if(__atomic_compare_exchange_n(&mem_stats->memory_peak, &peak, live, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)){
+                break;
+            }
+        }
+        size_t mark = __atomic_load_n(&mem_stats->memory_mark, __ATOMIC_RELAXED);
+        while(live > mark){
+            if(__atomic_compare_exchange_n(&mem_stats->memory_mark, &mark, live, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)){
+                break;
+            }
+        }
+        return;
+    }
+#endif
+    size_t live = mem_stats->memory_produce - mem_stats->memory_release;
+    if(live > mem_stats->memory_peak){
+        mem_stats->memory_peak = live;
+    }
+    if(live > mem_stats->memory_mark){
+        mem_stats->memory_mark = live;
+    }
+}
+#endif /*YAYA_MEMORY_STATS_OFF*/
 
 #if YAYA_MEMORY_STATS_USE && YAYA_MEMORY_STATS_GLOBAL
+#if YAYA_MEMORY_STATS_SHARD
+static mem_stats_shard_t mem_stats_shard[YAYA_MEMORY_STATS_SHARD];
+mem_stats_t mem_stats = {.memory_shard = mem_stats_shard};
+#else
 mem_stats_t mem_stats;
+#endif /*YAYA_MEMORY_STATS_SHARD*/
 #endif /*YAYA_MEMORY_STATS_GLOBAL*/
 
 #if YAYA_MEMORY_STATS_USE && !YAYA_MEMORY_STATS_OFF
@@ -31,6 +174,16 @@ bool memory_stats_init(mem_stats_t **mem_stats)
         }
 
         memset(*mem_stats, 0, malloc_usable_size(*mem_stats));
+
+#if YAYA_MEMORY_STATS_SHARD
+        (*mem_stats)->memory_shard = aligned_alloc(MEMORY_CACHE_LINE, sizeof(mem_stats_shard_t) * YAYA_MEMORY_STATS_SHARD);
+        if((*mem_stats)->memory_shard == NULL){
+            free(*mem_stats);
+            *mem_stats = NULL;
+            return false;
+        }
+        memset((*mem_stats)->memory_shard, 0, sizeof(mem_stats_shard_t) * YAYA_MEMORY_STATS_SHARD);
+#endif
         return true;
     }
 
@@ -40,6 +193,11 @@ bool memory_stats_init(mem_stats_t **mem_stats)
 bool memory_stats_free(mem_stats_t **mem_stats)
 {
     if(mem_stats != NULL){
+#if YAYA_MEMORY_STATS_SHARD
+        if(*mem_stats != NULL){
+            free((*mem_stats)->memory_shard);
+        }
+#endif
         free(*mem_stats);
         *mem_stats = NULL;
         return true;
@@ -47,195 +205,3434 @@ bool memory_stats_free(mem_stats_t **mem_stats)
     return false;
 }
 
+/*Сведение счетчиков без начала новой области, для вывода и выгрузки*/
+static bool memory_stats_merge(mem_stats_t *mem_stats, mem_stats_t *snapshot)
+{
+    if(mem_stats == NULL || snapshot == NULL){
+        return false;
+    }
+
+#if YAYA_MEMORY_STATS_SHARD
+    /*Снимок или разность уже сведены*/
+    if(mem_stats->memory_shard == NULL){
+        *snapshot = *mem_stats;
+        return true;
+    }
+
+    /*Сведение счетчиков всех потоков*/
+    memset(snapshot, 0, sizeof(mem_stats_t));
+    for(size_t i = 0; i < YAYA_MEMORY_STATS_SHARD; i++){
+        mem_stats_shard_t *shard = &mem_stats->memory_shard[i];
+        snapshot->memory_request  += atomic_load_explicit(&shard->memory_request,  memory_order_relaxed);
+        snapshot->memory_produce  += atomic_load_explicit(&shard->memory_produce,  memory_order_relaxed);
+        snapshot->memory_release  += atomic_load_explicit(&shard->memory_release,  memory_order_relaxed);
+        snapshot->memory_call_new += atomic_load_explicit(&shard->memory_call_new, memory_order_relaxed);
+        snapshot->memory_call_res += atomic_load_explicit(&shard->memory_call_res, memory_order_relaxed);
+        snapshot->memory_call_del += atomic_load_explicit(&shard->memory_call_del, memory_order_relaxed);
+        snapshot->memory_header   += atomic_load_explicit(&shard->memory_header,   memory_order_relaxed);
+#if YAYA_MEMORY_HUGE_USE
+        snapshot->memory_huge     += atomic_load_explicit(&shard->memory_huge,     memory_order_relaxed);
+#endif
+        snapshot->memory_hist_sum += atomic_load_explicit(&shard->memory_hist_sum, memory_order_relaxed);
+        for(size_t b = 0; b < YAYA_MEMORY_STATS_BUCKET; b++){
+            snapshot->memory_hist_request[b] += atomic_load_explicit(&shard->memory_hist_request[b], memory_order_relaxed);
+            snapshot->memory_hist_live[b]    += atomic_load_explicit(&shard->memory_hist_live[b],    memory_order_relaxed);
+        }
+    }
+    snapshot->memory_shard = NULL;
+    snapshot->memory_peak  = __atomic_load_n(&mem_stats->memory_peak, __ATOMIC_RELAXED);
+    snapshot->memory_mark  = __atomic_load_n(&mem_stats->memory_mark, __ATOMIC_RELAXED);
+
+    /*Пик не меньше текущего занятого*/
+    if(snapshot->memory_peak < snapshot->memory_produce - snapshot->memory_release){
+        snapshot->memory_peak = snapshot->memory_produce - snapshot->memory_release;
+    }
+    if(snapshot->memory_mark < snapshot->memory_produce - snapshot->memory_release){
+        snapshot->memory_mark = snapshot->memory_produce - snapshot->memory_release;
+    }
+#else
+    *snapshot = *mem_stats;
+#endif
+
+    return true;
+}
+
+bool memory_stats_snapshot(mem_stats_t *mem_stats, mem_stats_t *snapshot)
+{
+    return memory_stats_merge(mem_stats, snapshot);
+}
+
+bool memory_stats_mark(mem_stats_t *mem_stats)
+{
+    if(mem_stats == NULL){
+        return false;
+    }
+
+    /*Пик новой области начинается с занятого сейчас*/
+#if YAYA_MEMORY_STATS_SHARD
+    if(mem_stats->memory_shard != NULL){
+        __atomic_store_n(&mem_stats->memory_mark, __atomic_load_n(&mem_stats->memory_live, __ATOMIC_RELAXED), __ATOMIC_RELAXED);
+        return true;
+    }
+#endif
+    mem_stats->memory_mark = mem_stats->memory_produce - mem_stats->memory_release;
+
+    return true;
+}
+
+bool memory_stats_diff(const mem_stats_t *begin, const mem_stats_t *end, mem_stats_t *diff)
+{
+    if(begin == NULL || end == NULL || diff == NULL){
+        return false;
+    }
+
+    mem_stats_t res = {0};
+    res.memory_request  = end->memory_request  - begin->memory_request;
+    res.memory_produce  = end->memory_produce  - begin->memory_produce;
+    res.memory_release  = end->memory_release  - begin->memory_release;
+    res.memory_call_new = end->memory_call_new - begin->memory_call_new;
+    res.memory_call_res = end->memory_call_res - begin->memory_call_res;
+    res.memory_call_del = end->memory_call_del - begin->memory_call_del;
+    res.memory_header   = end->memory_header   - begin->memory_header;
+#if YAYA_MEMORY_HUGE_USE
+    res.memory_huge     = end->memory_huge     - begin->memory_huge;
+#endif
+    res.memory_hist_sum = end->memory_hist_sum - begin->memory_hist_sum;
+    for(size_t b = 0; b < YAYA_MEMORY_STATS_BUCKET; b++){
+        res.memory_hist_request[b] = end->memory_hist_request[b] - begin->memory_hist_request[b];
+        res.memory_hist_live[b]    = end->memory_hist_live[b]    - begin->memory_hist_live[b];
+    }
+
+    /*Пик области от занятого в начале, memory_mark отсчитывается от последнего memory_stats_mark*/
+    size_t live = begin->memory_produce - begin->memory_release;
+    res.memory_mark = end->memory_mark;
+    res.memory_peak = (end->memory_mark > live) ? end->memory_mark - live : 0;
+
+    *diff = res;
+    return true;
+}
+
 bool memory_stats_show(mem_stats_t *mem_stats)
 {
-    if(mem_stats != NULL){
-        printf("Request :% 10" PRIiMAX "; ", mem_stats->memory_request);
-        printf("NEW  :% 10" PRIiMAX "; ",    mem_stats->memory_call_new);
+    mem_stats_t snapshot = {0};
+    if(memory_stats_merge(mem_stats, &snapshot)){
+        mem_stats = &snapshot;
+        printf("Request :%10zu; ", mem_stats->memory_request);
+        printf("NEW  :%10zu; ",    mem_stats->memory_call_new);
+        printf("\n");
+        printf("Produce :%10zu; ", mem_stats->memory_produce);
+        printf("RES  :%10zu; ",    mem_stats->memory_call_res);
         printf("\n");
-        printf("Produce :% 10" PRIiMAX "; ", mem_stats->memory_produce);
-        printf("RES  :% 10" PRIiMAX "; ",    mem_stats->memory_call_res);
+        printf("Overhead:%10zu; ", mem_stats->memory_produce - mem_stats->memory_request);
+        printf("DEL  :%10zu; ",    mem_stats->memory_call_del);
         printf("\n");
-        printf("Overhead:% 10" PRIiMAX "; ", mem_stats->memory_produce - mem_stats->memory_request);
-        printf("DEL  :% 10" PRIiMAX "; ",    mem_stats->memory_call_del);
+        printf("Release :%10zu; ", mem_stats->memory_release);
+        printf("USAGE:%10zu; ",    mem_stats->memory_produce - mem_stats->memory_release);
+        printf("\n");
+        printf("Header  :%10zu; ", mem_stats->memory_header);
+#if YAYA_MEMORY_HUGE_USE
+        printf("HUGE :%10zu; ",    mem_stats->memory_huge);
+#endif
         printf("\n");
-        printf("Release :% 10" PRIiMAX "; ", mem_stats->memory_release);
-        printf("USAGE:% 10" PRIiMAX "; ",    mem_stats->memory_produce - mem_stats->memory_release);
+        printf("Peak    :%10zu; ", mem_stats->memory_peak);
         printf("\n");
 
+        /*Только непустые корзины*/
+        for(size_t b = 0; b < YAYA_MEMORY_STATS_BUCKET; b++){
+            if(mem_stats->memory_hist_request[b] != 0 || mem_stats->memory_hist_live[b] != 0){
+                printf("  <2^%-2zu :%10zu; ", b, mem_stats->memory_hist_request[b]);
+                printf("LIVE :%10zu; ",        mem_stats->memory_hist_live[b]);
+                printf("\n");
+            }
+        }
+
         if(fflush(stdout) == 0){
             return true;
         }
     }
     return false;
 }
-#endif
 
-bool memory_new(
-        #if YAYA_MEMORY_STATS_USE
-        mem_stats_t *mem_stats,
-        #endif
-        void **ptr,
-        void *old_ptr,
-        const size_t count,
-        const size_t size)
+/*Вывод выгрузки в буфер или в файл без выделения памяти*/
+typedef struct mem_out_t {
+    char  *buf;
+    size_t len;
+    size_t pos;
+    FILE  *file;
+    bool   fail;
+}mem_out_t;
+
+static void memory_out(mem_out_t *out, const char *format, ...)
 {
-#if YAYA_MEMORY_STATS_USE && YAYA_MEMORY_STATS_OFF
-    (void)(mem_stats);
+    va_list args;
+    va_start(args, format);
+    int res = 0;
+    if(out->file != NULL){
+        res = vfprintf(out->file, format, args);
+    }else{
+        size_t rest = (out->pos < out->len) ? out->len - out->pos : 0;
+        res = vsnprintf((rest != 0) ? out->buf + out->pos : NULL, rest, format, args);
+    }
+    va_end(args);
+
+    if(res < 0){
+        out->fail = true;
+        return;
+    }
+    out->pos += (size_t)(res);
+}
+
+/*Поле выгрузки: имя, имя и тип в Prometheus, значение*/
+typedef struct mem_field_t {
+    const char *name;
+    const char *prom;
+    const char *type;
+    size_t      value;
+}mem_field_t;
+
+static void memory_stats_out(mem_stats_t *mem_stats, mem_format_t format, mem_out_t *out)
+{
+    const mem_field_t field[] = {
+        {"request",  "request_bytes_total", "counter", mem_stats->memory_request},
+        {"produce",  "produce_bytes_total", "counter", mem_stats->memory_produce},
+        {"release",  "release_bytes_total", "counter", mem_stats->memory_release},
+        {"call_new", "call_new_total",      "counter", mem_stats->memory_call_new},
+        {"call_res", "call_res_total",      "counter", mem_stats->memory_call_res},
+        {"call_del", "call_del_total",      "counter", mem_stats->memory_call_del},
+        {"usage",    "usage_bytes",         "gauge",   mem_stats->memory_produce - mem_stats->memory_release},
+        {"header",   "header_bytes",        "gauge",   mem_stats->memory_header},
+        {"peak",     "peak_bytes",          "gauge",   mem_stats->memory_peak},
+#if YAYA_MEMORY_HUGE_USE
+        {"huge",     "huge_bytes",          "gauge",   mem_stats->memory_huge},
 #endif
+    };
+    const size_t count = sizeof(field) / sizeof(field[0]);
 
-    /*Указатели под структуру памяти*/
-    mem_info_t *mem_old = {0};
-    mem_info_t *mem_new = {0};
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
 
-    /*Проверка, что запрошено не нулевой размер памяти*/
-    const size_t new_size_len = (count * size);
-    if(new_size_len == 0){
-        return false;
-    }
+    switch(format){
+        case MEMORY_FORMAT_JSON:
+            memory_out(out, "{\"time\":%lld.%09ld", (long long)(ts.tv_sec), (long)(ts.tv_nsec));
+            for(size_t i = 0; i < count; i++){
+                memory_out(out, ",\"%s\":%zu", field[i].name, field[i].value);
+            }
+            memory_out(out, ",\"hist_request\":[");
+            for(size_t b = 0; b < YAYA_MEMORY_STATS_BUCKET; b++){
+                memory_out(out, (b == 0) ? "%zu" : ",%zu", mem_stats->memory_hist_request[b]);
+            }
+            memory_out(out, "],\"hist_live\":[");
+            for(size_t b = 0; b < YAYA_MEMORY_STATS_BUCKET; b++){
+                memory_out(out, (b == 0) ? "%zu" : ",%zu", mem_stats->memory_hist_live[b]);
+            }
+            memory_out(out, "]}\n");
+            break;
 
-    /*Проверка, что возвращать есть куда*/
-    if(ptr == NULL){
-        return false;
-    }
+        case MEMORY_FORMAT_CSV_HEAD:
+            memory_out(out, "time");
+            for(size_t i = 0; i < count; i++){
+                memory_out(out, ",%s", field[i].name);
+            }
+            for(size_t b = 0; b < YAYA_MEMORY_STATS_BUCKET; b++){
+                memory_out(out, ",hist_request_%zu", b);
+            }
+            for(size_t b = 0; b < YAYA_MEMORY_STATS_BUCKET; b++){
+                memory_out(out, ",hist_live_%zu", b);
+            }
+            memory_out(out, "\n");
+            break;
 
-    /*Если память не инициализирована, то указатель на предыдущую память NULL*/
-    if(old_ptr == NULL){
-        /*Выделение памяти под запрос и на хранение информации и указателя*/
-        mem_new = malloc(new_size_len + sizeof(mem_info_t));
+        case MEMORY_FORMAT_CSV:
+            memory_out(out, "%lld.%09ld", (long long)(ts.tv_sec), (long)(ts.tv_nsec));
+            for(size_t i = 0; i < count; i++){
+                memory_out(out, ",%zu", field[i].value);
+            }
+            for(size_t b = 0; b < YAYA_MEMORY_STATS_BUCKET; b++){
+                memory_out(out, ",%zu", mem_stats->memory_hist_request[b]);
+            }
+            for(size_t b = 0; b < YAYA_MEMORY_STATS_BUCKET; b++){
+                memory_out(out, ",%zu", mem_stats->memory_hist_live[b]);
+            }
+            memory_out(out, "\n");
+            break;
 
-        /*Проверка, что память выделилась*/
-        if(mem_new == NULL){
-            return false;
-        }
+        case MEMORY_FORMAT_PROM:
+            for(size_t i = 0; i < count; i++){
+                memory_out(out, "# TYPE yaya_memory_%s %s\n", field[i].prom, field[i].type);
+                memory_out(out, "yaya_memory_%s %zu\n", field[i].prom, field[i].value);
+            }
+            /*Запросы как гистограмма Prometheus: корзина i для [2^(i-1), 2^i), поэтому граница le = 2^i - 1,
+              счет накопленный, последняя корзина собирает все большее и идет в +Inf*/
+            memory_out(out, "# TYPE yaya_memory_request_size_bytes histogram\n");
+            size_t total = 0;
+            for(size_t b = 0; b + 1 < YAYA_MEMORY_STATS_BUCKET; b++){
+                total += mem_stats->memory_hist_request[b];
+                memory_out(out, "yaya_memory_request_size_bytes_bucket{le=\"%zu\"} %zu\n", ((size_t)(1) << b) - 1, total);
+            }
+            total += mem_stats->memory_hist_request[YAYA_MEMORY_STATS_BUCKET - 1];
+            memory_out(out, "yaya_memory_request_size_bytes_bucket{le=\"+Inf\"} %zu\n", total);
+            memory_out(out, "yaya_memory_request_size_bytes_sum %zu\n", mem_stats->memory_hist_sum);
+            memory_out(out, "yaya_memory_request_size_bytes_count %zu\n", total);
+            /*Живые байты не наблюдения, а занятое по корзинам: gauge с меткой корзины без накопления, только непустые*/
+            memory_out(out, "# TYPE yaya_memory_hist_live_bytes gauge\n");
+            for(size_t b = 0; b + 1 < YAYA_MEMORY_STATS_BUCKET; b++){
+                if(mem_stats->memory_hist_live[b] != 0){
+                    memory_out(out, "yaya_memory_hist_live_bytes{bucket=\"%zu\"} %zu\n", ((size_t)(1) << b) - 1, mem_stats->memory_hist_live[b]);
+                }
+            }
+            if(mem_stats->memory_hist_live[YAYA_MEMORY_STATS_BUCKET - 1] != 0){
+                memory_out(out, "yaya_memory_hist_live_bytes{bucket=\"+Inf\"} %zu\n", mem_stats->memory_hist_live[YAYA_MEMORY_STATS_BUCKET - 1]);
+            }
+            break;
 
-        size_t produce = malloc_usable_size(mem_new);
+        default:
+            out->fail = true;
+            break;
+    }
+}
 
-        /*Зануление всего выделенного*/
-        memset(mem_new, 0x00, new_size_len + sizeof(mem_info_t));
-        memset(mem_new + (new_size_len + sizeof(mem_info_t)), YAYA_MEMORY_VALUE_AFTER_MEM, produce - (new_size_len + sizeof(mem_info_t)));
+size_t memory_stats_export(mem_stats_t *mem_stats, mem_format_t format, char *buf, size_t len)
+{
+    mem_stats_t snapshot = {0};
+    if(!memory_stats_merge(mem_stats, &snapshot)){
+        return 0;
+    }
 
-        /*Сохранение информации о количестве памяти*/
-        mem_new->memory_request = new_size_len;
-        mem_new->memory_produce = produce;
+    mem_out_t out = {.buf = buf, .len = (buf != NULL) ? len : 0};
+    memory_stats_out(&snapshot, format, &out);
 
-        /*Возвращение указателя на память для пользователя*/
-        *ptr = mem_new->memory_ptr;
+    return out.fail ? 0 : out.pos;
+}
 
-#if YAYA_MEMORY_STATS_USE && !YAYA_MEMORY_STATS_OFF
-        /*Сохранение статистики*/
-        if(mem_stats != NULL){
-            mem_stats->memory_call_new++;
-            mem_stats->memory_request += mem_new->memory_request;
-            mem_stats->memory_produce += mem_new->memory_produce;
-        }
-#endif
+bool memory_stats_write(mem_stats_t *mem_stats, mem_format_t format, FILE *file)
+{
+    if(file == NULL){
+        return false;
     }
-    /*Если память инициализированна, то указатель на предыдущую память не NULL*/
-    else
-    {
-        /*Помещаем указатель со смещением*/
-        mem_old = old_ptr - offsetof(mem_info_t, memory_ptr);
 
-        /*Запоминаем сколько было выделено и сколько запрошено*/
-        size_t old_size_r = mem_old->memory_request;
-#if YAYA_MEMORY_STATS_USE && !YAYA_MEMORY_STATS_OFF
-        size_t old_size_p = mem_old->memory_produce;
-#endif
-        /*Перераспределяем память*/
-        mem_new = realloc(mem_old, new_size_len + sizeof(mem_info_t));
+    mem_stats_t snapshot = {0};
+    if(!memory_stats_merge(mem_stats, &snapshot)){
+        return false;
+    }
 
-        /*Проверка, что память выделилась*/
-        if(mem_new == NULL){
-            return false;
-        }
+    mem_out_t out = {.file = file};
+    memory_stats_out(&snapshot, format, &out);
 
-        /*Запоминаем сколько выделено и сколько запрошено*/
-        size_t new_size_p = malloc_usable_size(mem_new);
-        size_t new_size_r = new_size_len;
+    return !out.fail && fflush(file) == 0;
+}
 
-        /*Вычисление разницы*/
-        intptr_t diff_r = (intptr_t)(new_size_r) - (intptr_t)(old_size_r);
-#if YAYA_MEMORY_STATS_USE && !YAYA_MEMORY_STATS_OFF
-        intptr_t diff_p = (intptr_t)(new_size_p) - (intptr_t)(old_size_p);
-#endif
-        /*Зануление хвоста выделенного*/
-        if(diff_r > 0){
-            size_t diff = new_size_p - offsetof(mem_info_t, memory_ptr) - old_size_r;
-            memset(mem_new->memory_ptr + old_size_r, 0x00, diff);
-        }
-        if(diff_r < 0){
-            size_t diff = new_size_p - offsetof(mem_info_t, memory_ptr) - new_size_r;
-            memset(mem_new->memory_ptr + new_size_r, 0x00, diff);
-        }
+#if YAYA_MEMORY_STATS_REPORT
+struct mem_report_t {
+    pthread_t       thread;
+    pthread_mutex_t lock;
+    pthread_cond_t  cond;
+    bool            stop;
+    mem_stats_t    *mem_stats;
+    mem_format_t    format;
+    FILE           *file;
+    size_t          period_ms;
+};
 
-        /*Сохранение информации о количестве запрощеной памяти*/
-        mem_new->memory_produce = new_size_p;
-        mem_new->memory_request = new_size_r;
+static void *memory_report_thread(void *arg)
+{
+    mem_report_t *report = arg;
 
-        /*Возвращение указателя на память для пользователя*/
-        *ptr = mem_new->memory_ptr;
+    if(report->format == MEMORY_FORMAT_CSV){
+        memory_stats_write(report->mem_stats, MEMORY_FORMAT_CSV_HEAD, report->file);
+    }
 
-#if YAYA_MEMORY_STATS_USE && !YAYA_MEMORY_STATS_OFF
-        /*Сохранение статистики*/
-        if(mem_stats != NULL){
-            mem_stats->memory_call_res++;
-            mem_stats->memory_request += (size_t)(diff_r);
-            mem_stats->memory_produce += (size_t)(diff_p);
+    pthread_mutex_lock(&report->lock);
+    while(!report->stop){
+        /*Ожидание периода или остановки*/
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec  += (time_t)(report->period_ms / 1000);
+        deadline.tv_nsec += (long)(report->period_ms % 1000) * 1000000L;
+        if(deadline.tv_nsec >= 1000000000L){
+            deadline.tv_sec  += 1;
+            deadline.tv_nsec -= 1000000000L;
         }
-#endif
+        int res = 0;
+        while(!report->stop && res != ETIMEDOUT){
+            res = pthread_cond_timedwait(&report->cond, &report->lock, &deadline);
+        }
+        if(report->stop){
+            break;
+        }
+
+        pthread_mutex_unlock(&report->lock);
+        memory_stats_write(report->mem_stats, report->format, report->file);
+        pthread_mutex_lock(&report->lock);
     }
-    return true;
+    pthread_mutex_unlock(&report->lock);
+
+    return NULL;
 }
 
-bool memory_del(
-        #if YAYA_MEMORY_STATS_USE
-        mem_stats_t *mem_stats,
-        #endif
-        void **ptr)
+bool memory_stats_report_start(mem_report_t **report, mem_stats_t *mem_stats, mem_format_t format, FILE *file, size_t period_ms)
 {
-#if YAYA_MEMORY_STATS_USE && YAYA_MEMORY_STATS_OFF
-    (void)(mem_stats);
-#endif
+    if(report == NULL || *report != NULL || mem_stats == NULL || file == NULL || period_ms == 0){
+        return false;
+    }
 
-    /*Проверка, что указатели не NULL*/
-    if(ptr == NULL){
+    mem_report_t *rep = malloc(sizeof(mem_report_t));
+    if(rep == NULL){
         return false;
     }
+    memset(rep, 0, sizeof(mem_report_t));
+    rep->mem_stats = mem_stats;
+    rep->format    = format;
+    rep->file      = file;
+    rep->period_ms = period_ms;
+    pthread_mutex_init(&rep->lock, NULL);
+    pthread_cond_init(&rep->cond, NULL);
 
-    if(*ptr == NULL){
+    if(pthread_create(&rep->thread, NULL, memory_report_thread, rep) != 0){
+        pthread_cond_destroy(&rep->cond);
+        pthread_mutex_destroy(&rep->lock);
+        free(rep);
         return false;
     }
 
-    /*Указатели под структуру памяти*/
-    mem_info_t *mem = NULL;
+    *report = rep;
+    return true;
+}
 
-    /*Помещаем указатель со смещением*/
-    mem = *ptr - offsetof(mem_info_t, memory_ptr);
+bool memory_stats_report_stop(mem_report_t **report)
+{
+    if(report == NULL || *report == NULL){
+        return false;
+    }
 
-#if YAYA_MEMORY_STATS_USE && !YAYA_MEMORY_STATS_OFF
-    /*Сохранение статистики*/
-    if(mem_stats != NULL){
-        mem_stats->memory_call_del++;
-        mem_stats->memory_release += mem->memory_produce;
+    mem_report_t *rep = *report;
+    pthread_mutex_lock(&rep->lock);
+    rep->stop = true;
+    pthread_cond_signal(&rep->cond);
+    pthread_mutex_unlock(&rep->lock);
+    pthread_join(rep->thread, NULL);
+
+    pthread_cond_destroy(&rep->cond);
+    pthread_mutex_destroy(&rep->lock);
+    free(rep);
+    *report = NULL;
+
+    return true;
+}
+#endif /*YAYA_MEMORY_STATS_REPORT*/
+#endif
+
+/*Затирание памяти, которое компилятор не может выбросить.
+  Большие блоки пишутся потоковыми записями, чтобы не вытеснять кэш*/
+static void memory_wipe(void *ptr, uint8_t value, size_t len)
+{
+    uint8_t *p = ptr;
+
+#if defined(__SSE2__)
+    if(len >= YAYA_MEMORY_WIPE_STREAM){
+        /*Начало до выравнивания на 16 байт*/
+        size_t head = (16 - ((uintptr_t)(p) & 15U)) & 15U;
+        memset(p, value, head);
+        p   += head;
+        len -= head;
+
+        const __m128i fill = _mm_set1_epi8((char)(value));
+        for(; len >= 64; p += 64, len -= 64){
+            _mm_stream_si128((__m128i*)(p) + 0, fill);
+            _mm_stream_si128((__m128i*)(p) + 1, fill);
+            _mm_stream_si128((__m128i*)(p) + 2, fill);
+            _mm_stream_si128((__m128i*)(p) + 3, fill);
+        }
+        _mm_sfence();
     }
 #endif
 
-#if YAYA_MEMORY_FILL_NULL_AFTER_FREE
-    volatile uintptr_t size = mem->memory_produce;
-    volatile uint8_t  *p    = (uint8_t*)(mem);
-    while (size--){
-        *(p++) = YAYA_MEMORY_VALUE_AFTER_MEM;
+    memset(p, value, len);
+
+    /*Барьер, запись считается наблюдаемой*/
+    __asm__ __volatile__("" : : "r"(ptr) : "memory");
+}
+
+#if YAYA_MEMORY_LATENCY_USE
+/*Лог-линейные корзины как в HDR: 2^(SUB_BITS-1) корзин на каждую степень двойки*/
+#define MEMORY_LATENCY_SUB_BITS 5U
+#define MEMORY_LATENCY_HALF     ((size_t)(1) << (MEMORY_LATENCY_SUB_BITS - 1))
+#define MEMORY_LATENCY_BUCKET   ((66 - MEMORY_LATENCY_SUB_BITS) * MEMORY_LATENCY_HALF)
+
+/*Счетчики одного потока, пишет только владелец, читают все*/
+typedef struct mem_latency_hist_t {
+    size_t memory_count[MEMORY_LATENCY_KIND][MEMORY_LATENCY_BUCKET];
+    struct mem_latency_hist_t *memory_next;
+}mem_latency_hist_t;
+
+/*Замер одного вызова, закрывается при выходе из области видимости*/
+typedef struct mem_latency_scope_t {
+    uint64_t memory_begin;
+    size_t   memory_kind;
+}mem_latency_scope_t;
+
+static mem_latency_hist_t *memory_latency_list = NULL;
+static _Thread_local mem_latency_hist_t *memory_latency_local = NULL;
+
+/*Начальная точка для пересчета тактов в наносекунды*/
+static uint64_t memory_latency_tick_beg = 0;
+static uint64_t memory_latency_nano_beg = 0;
+
+static inline uint64_t memory_latency_nano(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)(ts.tv_sec) * 1000000000U + (uint64_t)(ts.tv_nsec);
+}
+
+/*Дешевые часы: счетчик тактов на x86, иначе CLOCK_MONOTONIC*/
+static inline uint64_t memory_latency_tick(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return memory_latency_nano();
+#endif
+}
+
+static inline size_t memory_latency_bucket(uint64_t value)
+{
+    if(value < 2 * MEMORY_LATENCY_HALF){
+        return (size_t)(value);
+    }
+    size_t shift = (size_t)(63 - __builtin_clzll((unsigned long long)(value))) - (MEMORY_LATENCY_SUB_BITS - 1);
+    return shift * MEMORY_LATENCY_HALF + (size_t)(value >> shift);
+}
+
+/*Середина корзины в тактах*/
+static inline uint64_t memory_latency_value(size_t bucket)
+{
+    if(bucket < 2 * MEMORY_LATENCY_HALF){
+        return bucket;
+    }
+    size_t shift = bucket / MEMORY_LATENCY_HALF - 1;
+    uint64_t low = (uint64_t)(bucket % MEMORY_LATENCY_HALF + MEMORY_LATENCY_HALF) << shift;
+    return low + ((uint64_t)(1) << shift) / 2;
+}
+
+/*Гистограмма потока заводится при первом замере и остается до конца процесса*/
+__attribute__((noinline, cold))
+static mem_latency_hist_t *memory_latency_init(void)
+{
+    mem_latency_hist_t *hist = calloc(1, sizeof(mem_latency_hist_t));
+    if(hist == NULL){
+        return NULL;
+    }
+
+    uint64_t zero = 0;
+    uint64_t tick = memory_latency_tick();
+    if(__atomic_compare_exchange_n(&memory_latency_tick_beg, &zero, tick, false, __ATOMIC_RELAXED, __ATOMIC_RELAXED)){
+        __atomic_store_n(&memory_latency_nano_beg, memory_latency_nano(), __ATOMIC_RELEASE);
+    }
+
+    hist->memory_next = __atomic_load_n(&memory_latency_list, __ATOMIC_RELAXED);
+    while(!__atomic_compare_exchange_n(&memory_latency_list, &hist->memory_next, hist, true, __ATOMIC_RELEASE, __ATOMIC_RELAXED)){
+    }
+    memory_latency_local = hist;
+    return hist;
+}
+
+static inline mem_latency_scope_t memory_latency_begin(size_t kind)
+{
+    return (mem_latency_scope_t){memory_latency_tick(), kind};
+}
+
+static inline void memory_latency_end(mem_latency_scope_t *scope)
+{
+    uint64_t tick = memory_latency_tick() - scope->memory_begin;
+    mem_latency_hist_t *hist = memory_latency_local;
+    if(__builtin_expect(hist == NULL, 0)){
+        hist = memory_latency_init();
+        if(hist == NULL){
+            return;
+        }
+    }
+
+    /*Без атомарного сложения, счетчик пишет один поток*/
+    size_t *count = &hist->memory_count[scope->memory_kind][memory_latency_bucket(tick)];
+    __atomic_store_n(count, __atomic_load_n(count, __ATOMIC_RELAXED) + 1, __ATOMIC_RELAXED);
+}
+
+#define MEMORY_LATENCY_SCOPE(K) \
+    mem_latency_scope_t memory_latency_scope __attribute__((cleanup(memory_latency_end))) = memory_latency_begin(K)
+#else
+#define MEMORY_LATENCY_SCOPE(K) ((void)(0))
+#endif /*YAYA_MEMORY_LATENCY_USE*/
+
+/*Источник блока в поле memory_flags*/
+#define MEMORY_KIND_MASK   0x0FU
+#define MEMORY_KIND_HEAP   0x00U
+#define MEMORY_KIND_SLAB   0x01U
+#define MEMORY_KIND_ARENA  0x02U
+#define MEMORY_KIND_MMAP   0x03U
+#define MEMORY_KIND_ALIGN  0x04U
+#define MEMORY_FLAG_HUGE    0x10U
+#define MEMORY_FLAG_HUGETLB 0x20U
+#define MEMORY_FLAG_SAMPLE  0x40U
+#define MEMORY_FLAG_GUARD   0x80U
+#define MEMORY_CLASS_SHIFT 8U
+#define MEMORY_CLASS_MASK  0xFFU
+#define MEMORY_SITE_SHIFT  16U
+#define MEMORY_SITE_MASK   0xFFFFFFFFU
+#define MEMORY_TAG_SHIFT   48U
+#define MEMORY_TAG_MASK    0xFFFFU
+
+#if YAYA_MEMORY_SLAB_USE
+/*Свободный блок сляба, ссылка хранится в самом блоке*/
+typedef struct mem_slab_free_t {
+    struct mem_slab_free_t *next;
+}mem_slab_free_t;
+
+/*Список свободных блоков одного класса*/
+typedef struct mem_slab_t {
+    atomic_flag      lock;
+    mem_slab_free_t *free;
+}mem_slab_t;
+
+static const size_t memory_slab_class[] = { YAYA_MEMORY_SLAB_CLASS };
+
+#define MEMORY_SLAB_COUNT (sizeof(memory_slab_class) / sizeof(memory_slab_class[0]))
+
+static mem_slab_t memory_slab[MEMORY_SLAB_COUNT] = {{ATOMIC_FLAG_INIT, NULL}};
+
+/*Размер блока класса вместе с заголовком, кратно max_align_t*/
+static inline size_t memory_slab_block(size_t slab_class)
+{
+    size_t block = sizeof(mem_info_t) + memory_slab_class[slab_class];
+    return (block + alignof(max_align_t) - 1) & ~(alignof(max_align_t) - 1);
+}
+
+/*Поиск наименьшего класса под запрос, MEMORY_SLAB_COUNT если не подходит*/
+static inline size_t memory_slab_find(size_t request)
+{
+    size_t slab_class = 0;
+    while(slab_class < MEMORY_SLAB_COUNT && memory_slab_class[slab_class] < request){
+        slab_class++;
+    }
+    return slab_class;
+}
+
+static inline void memory_slab_lock(mem_slab_t *slab)
+{
+    while(atomic_flag_test_and_set_explicit(&slab->lock, memory_order_acquire)){
+        /*Ожидание*/
+    }
+}
+
+static inline void memory_slab_unlock(mem_slab_t *slab)
+{
+    atomic_flag_clear_explicit(&slab->lock, memory_order_release);
+}
+
+/*Нарезка нового сляба на блоки, вызывается под блокировкой*/
+static bool memory_slab_grow(size_t slab_class)
+{
+    size_t block = memory_slab_block(slab_class);
+    size_t count = YAYA_MEMORY_SLAB_PAGE / block;
+    if(count == 0){
+        return false;
+    }
+
+    uint8_t *page = malloc(YAYA_MEMORY_SLAB_PAGE);
+    if(page == NULL){
+        return false;
+    }
+
+    /*Слябы не возвращаются системе, блоки переиспользуются*/
+    mem_slab_t *slab = &memory_slab[slab_class];
+    for(size_t i = count; i > 0; i--){
+        mem_slab_free_t *free_block = (mem_slab_free_t*)(page + (i - 1) * block);
+        free_block->next = slab->free;
+        slab->free = free_block;
+    }
+    return true;
+}
+
+static void *memory_slab_pop(size_t slab_class)
+{
+    mem_slab_t *slab = &memory_slab[slab_class];
+    mem_slab_free_t *free_block = NULL;
+
+    memory_slab_lock(slab);
+    if(slab->free != NULL || memory_slab_grow(slab_class)){
+        free_block = slab->free;
+        slab->free = free_block->next;
+    }
+    memory_slab_unlock(slab);
+
+    return free_block;
+}
+
+static void memory_slab_push(size_t slab_class, void *block)
+{
+    mem_slab_t *slab = &memory_slab[slab_class];
+    mem_slab_free_t *free_block = block;
+
+    memory_slab_lock(slab);
+    free_block->next = slab->free;
+    slab->free = free_block;
+    memory_slab_unlock(slab);
+}
+
+/*Выдача нескольких блоков класса за одну блокировку*/
+static size_t memory_slab_pop_batch(size_t slab_class, void **block, size_t count)
+{
+    mem_slab_t *slab = &memory_slab[slab_class];
+    size_t i = 0;
+
+    memory_slab_lock(slab);
+    for(; i < count; i++){
+        if(slab->free == NULL && !memory_slab_grow(slab_class)){
+            break;
+        }
+        block[i] = slab->free;
+        slab->free = slab->free->next;
+    }
+    memory_slab_unlock(slab);
+
+    return i;
+}
+
+/*Возврат цепочки блоков класса за одну блокировку*/
+static void memory_slab_push_chain(size_t slab_class, mem_slab_free_t *head, mem_slab_free_t *tail)
+{
+    mem_slab_t *slab = &memory_slab[slab_class];
+
+    memory_slab_lock(slab);
+    tail->next = slab->free;
+    slab->free = head;
+    memory_slab_unlock(slab);
+}
+#endif /*YAYA_MEMORY_SLAB_USE*/
+
+#if YAYA_MEMORY_MMAP_USE
+/*Округление размера вверх до целых страниц*/
+static inline size_t memory_page_round(size_t size)
+{
+    static size_t page = 0;
+    if(page == 0){
+        page = (size_t)(sysconf(_SC_PAGESIZE));
+    }
+    return (size + page - 1) & ~(page - 1);
+}
+#endif /*YAYA_MEMORY_MMAP_USE*/
+
+#if YAYA_MEMORY_HUGE_USE
+/*Округление размера вверх до целых больших страниц*/
+static inline size_t memory_huge_round(size_t size)
+{
+    return (size + YAYA_MEMORY_HUGE_PAGE - 1) & ~(size_t)(YAYA_MEMORY_HUGE_PAGE - 1);
+}
+
+/*Байты блока на больших страницах для статистики*/
+static inline size_t memory_huge_size(size_t flags, size_t produce)
+{
+    return (flags & MEMORY_FLAG_HUGE) ? produce : 0;
+}
+
+/*Участок с началом на границе большой страницы, лишнее по краям возвращается*/
+static uint8_t *memory_huge_align(size_t size)
+{
+    uint8_t *raw = mmap(NULL, size + YAYA_MEMORY_HUGE_PAGE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(raw == MAP_FAILED){
+        return NULL;
+    }
+    uint8_t *ptr = (uint8_t*)(((uintptr_t)(raw) + YAYA_MEMORY_HUGE_PAGE - 1) & ~(uintptr_t)(YAYA_MEMORY_HUGE_PAGE - 1));
+    size_t head = (size_t)(ptr - raw);
+    size_t tail = YAYA_MEMORY_HUGE_PAGE - head;
+    if(head != 0){
+        munmap(raw, head);
+    }
+    if(tail != 0){
+        munmap(ptr + size, tail);
+    }
+    return ptr;
+}
+
+/*Отображение на больших страницах: сначала из hugetlbfs,
+  иначе участок с выравниванием на большую страницу и MADV_HUGEPAGE*/
+static void *memory_huge_map(size_t size, size_t *flags)
+{
+#ifdef MAP_HUGETLB
+    void *map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if(map != MAP_FAILED){
+        *flags |= MEMORY_FLAG_HUGETLB;
+        return map;
+    }
+#endif
+
+    uint8_t *ptr = memory_huge_align(size);
+    if(ptr == NULL){
+        return NULL;
+    }
+
+#ifdef MADV_HUGEPAGE
+    madvise(ptr, size, MADV_HUGEPAGE);
+#endif
+    return ptr;
+}
+
+/*Изменение размера блока на больших страницах без копирования.
+  MREMAP_MAYMOVE выбирает адрес без учета выравнивания, поэтому при переезде
+  страницы переносятся на заранее выровненный участок через MREMAP_FIXED*/
+static void *memory_huge_move(void *ptr, size_t old_size, size_t new_size)
+{
+    void *map = mremap(ptr, old_size, new_size, 0);
+    if(map != MAP_FAILED){
+        return map;
+    }
+
+    uint8_t *target = memory_huge_align(new_size);
+    if(target == NULL){
+        return NULL;
+    }
+    map = mremap(ptr, old_size, new_size, MREMAP_MAYMOVE | MREMAP_FIXED, target);
+    if(map == MAP_FAILED){
+        munmap(target, new_size);
+        return NULL;
+    }
+    return map;
+}
+#endif /*YAYA_MEMORY_HUGE_USE*/
+
+/*Размер заголовка перед памятью пользователя*/
+#if YAYA_MEMORY_INFO_MODE == 2
+#define MEMORY_INFO_SIZE ((size_t)(0))
+#else
+#define MEMORY_INFO_SIZE sizeof(mem_info_t)
+#endif /*YAYA_MEMORY_INFO_MODE*/
+
+#if YAYA_MEMORY_INFO_MODE == 2
+/*Внешняя таблица сведений, открытая адресация по указателю пользователя*/
+#define MEMORY_SIDE_TOMB ((uint8_t*)(uintptr_t)(1))
+
+static mem_info_t memory_side[YAYA_MEMORY_INFO_SIDE];
+
+static inline size_t memory_side_hash(const void *ptr)
+{
+    uint64_t key = (uint64_t)((uintptr_t)(ptr) >> 4);
+    return (size_t)((key * 0x9E3779B97F4A7C15ULL) >> 20) & (YAYA_MEMORY_INFO_SIDE - 1);
+}
+
+static mem_info_t *memory_side_find(const void *ptr)
+{
+    size_t hash = memory_side_hash(ptr);
+    for(size_t i = 0; i < YAYA_MEMORY_INFO_SIDE; i++){
+        mem_info_t *mem = &memory_side[(hash + i) & (YAYA_MEMORY_INFO_SIDE - 1)];
+        uint8_t *key = __atomic_load_n(&mem->memory_ptr, __ATOMIC_ACQUIRE);
+        if(key == ptr){
+            return mem;
+        }
+        if(key == NULL){
+            return NULL;
+        }
+    }
+    return NULL;
+}
+
+/*Удаленные записи не обрывают поиск, их число ограничивается очисткой.
+  Занятие идет под счетчиком в memory_side_gate (по 2 на поток), очистка ставит младший бит,
+  когда занимающих нет. Поиск и удаление остаются без блокировки*/
+static atomic_size_t memory_side_gate;
+static atomic_size_t memory_side_tomb;
+static atomic_size_t memory_side_limit = YAYA_MEMORY_INFO_SIDE / 4;
+
+/*Занятие свободной или удаленной записи*/
+static mem_info_t *memory_side_bind(void *ptr)
+{
+    size_t gate = atomic_load_explicit(&memory_side_gate, memory_order_relaxed);
+    for(;;){
+        if(gate & 1){
+            gate = atomic_load_explicit(&memory_side_gate, memory_order_relaxed);
+            continue;
+        }
+        if(atomic_compare_exchange_weak_explicit(&memory_side_gate, &gate, gate + 2, memory_order_acquire, memory_order_relaxed)){
+            break;
+        }
+    }
+
+    mem_info_t *res = NULL;
+    size_t hash = memory_side_hash(ptr);
+    for(size_t i = 0; i < YAYA_MEMORY_INFO_SIDE && res == NULL; i++){
+        mem_info_t *mem = &memory_side[(hash + i) & (YAYA_MEMORY_INFO_SIDE - 1)];
+        uint8_t *key = __atomic_load_n(&mem->memory_ptr, __ATOMIC_ACQUIRE);
+        while(key == NULL || key == MEMORY_SIDE_TOMB){
+            if(__atomic_compare_exchange_n(&mem->memory_ptr, &key, (uint8_t*)(ptr), false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)){
+                if(key == MEMORY_SIDE_TOMB){
+                    atomic_fetch_sub_explicit(&memory_side_tomb, 1, memory_order_relaxed);
+                }
+                res = mem;
+                break;
+            }
+        }
+    }
+
+    atomic_fetch_sub_explicit(&memory_side_gate, 2, memory_order_release);
+    return res;
+}
+
+/*Удаленная запись перед свободной не лежит ни на чьем пути поиска и становится свободной.
+  Проход назад по кругу собирает целые хвосты удаленных за один раз*/
+static void memory_side_clean(void)
+{
+    size_t gate = 0;
+    if(!atomic_compare_exchange_strong_explicit(&memory_side_gate, &gate, 1, memory_order_acquire, memory_order_relaxed)){
+        return;
+    }
+
+    for(size_t n = 2 * YAYA_MEMORY_INFO_SIDE; n > 0; n--){
+        size_t i = (n - 1) & (YAYA_MEMORY_INFO_SIDE - 1);
+        uint8_t *next = __atomic_load_n(&memory_side[(i + 1) & (YAYA_MEMORY_INFO_SIDE - 1)].memory_ptr, __ATOMIC_ACQUIRE);
+        uint8_t *key  = MEMORY_SIDE_TOMB;
+        if(next == NULL && __atomic_compare_exchange_n(&memory_side[i].memory_ptr, &key, NULL, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)){
+            atomic_fetch_sub_explicit(&memory_side_tomb, 1, memory_order_relaxed);
+        }
+    }
+
+    /*Оставшиеся удаленные внутри занятых цепочек, следующая очистка после новых*/
+    atomic_store_explicit(&memory_side_limit, atomic_load_explicit(&memory_side_tomb, memory_order_relaxed) + YAYA_MEMORY_INFO_SIDE / 4, memory_order_relaxed);
+    atomic_store_explicit(&memory_side_gate, 0, memory_order_release);
+}
+
+static void memory_side_unbind(mem_info_t *mem)
+{
+    __atomic_store_n(&mem->memory_ptr, MEMORY_SIDE_TOMB, __ATOMIC_RELEASE);
+    size_t tomb = atomic_fetch_add_explicit(&memory_side_tomb, 1, memory_order_relaxed) + 1;
+    if(tomb > atomic_load_explicit(&memory_side_limit, memory_order_relaxed)){
+        memory_side_clean();
+    }
+}
+#endif /*YAYA_MEMORY_INFO_MODE*/
+
+/*Получение сведений о блоке по указателю пользователя*/
+static inline mem_info_t *memory_info(void *ptr)
+{
+#if YAYA_MEMORY_INFO_MODE == 2
+    return memory_side_find(ptr);
+#else
+    return (mem_info_t*)((uint8_t*)(ptr) - offsetof(mem_info_t, memory_ptr));
+#endif
+}
+
+/*Привязка сведений к началу выделенной памяти*/
+static inline mem_info_t *memory_info_bind(void *base)
+{
+#if YAYA_MEMORY_INFO_MODE == 2
+    return memory_side_bind(base);
+#else
+    return (mem_info_t*)(base);
+#endif
+}
+
+static inline void memory_info_unbind(mem_info_t *mem)
+{
+#if YAYA_MEMORY_INFO_MODE == 2
+    memory_side_unbind(mem);
+#else
+    (void)(mem);
+#endif
+}
+
+/*Начало выделенной памяти*/
+static inline void *memory_info_base(mem_info_t *mem)
+{
+#if YAYA_MEMORY_INFO_MODE == 2
+    return mem->memory_ptr;
+#else
+    return mem;
+#endif
+}
+
+/*Выделено вместе с заголовком, сжатый заголовок берет размер у malloc*/
+static inline size_t memory_info_produce(mem_info_t *mem)
+{
+#if YAYA_MEMORY_INFO_MODE == 1
+    return malloc_usable_size(mem);
+#else
+    return mem->memory_produce;
+#endif
+}
+
+static inline void memory_info_produce_set(mem_info_t *mem, size_t produce)
+{
+#if YAYA_MEMORY_INFO_MODE == 1
+    (void)(mem);
+    (void)(produce);
+#else
+    mem->memory_produce = produce;
+#endif
+}
+
+static inline size_t memory_info_flags(mem_info_t *mem)
+{
+#if YAYA_MEMORY_INFO_FLAGS
+    return mem->memory_flags;
+#else
+    (void)(mem);
+    return MEMORY_KIND_HEAP;
+#endif
+}
+
+#if YAYA_MEMORY_SITE_USE
+/*Таблица мест вызова, номер места хранится в memory_flags блока*/
+static mem_site_t *memory_site_table[YAYA_MEMORY_SITE_COUNT];
+static size_t memory_site_count = 0;
+
+/*Место вызова текущего memory_new_site в этом потоке*/
+static _Thread_local mem_site_t *memory_site_current = NULL;
+
+/*Номер места в таблице, при первом вызове место регистрируется.
+  При переполнении таблицы место не учитывается и номер 0*/
+static size_t memory_site_index(mem_site_t *site)
+{
+    size_t index = __atomic_load_n(&site->memory_index, __ATOMIC_ACQUIRE);
+    if(index != 0){
+        return index;
+    }
+
+    size_t slot = __atomic_fetch_add(&memory_site_count, 1, __ATOMIC_RELAXED);
+    if(slot >= YAYA_MEMORY_SITE_COUNT){
+        return 0;
+    }
+
+    /*При гонке двух потоков лишняя запись таблицы остается пустой*/
+    __atomic_store_n(&memory_site_table[slot], site, __ATOMIC_RELEASE);
+    if(!__atomic_compare_exchange_n(&site->memory_index, &index, slot + 1, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)){
+        __atomic_store_n(&memory_site_table[slot], NULL, __ATOMIC_RELEASE);
+        return index;
+    }
+    return slot + 1;
+}
+
+static inline mem_site_t *memory_site_of(size_t flags)
+{
+    size_t index = (flags >> MEMORY_SITE_SHIFT) & MEMORY_SITE_MASK;
+    return (index != 0) ? __atomic_load_n(&memory_site_table[index - 1], __ATOMIC_RELAXED) : NULL;
+}
+
+/*Перенос живых байт блока от прежнего места к site, без site место не меняется.
+  К запрошенному месту прибавляется только рост блока, как в memory_stats*/
+static void memory_site_move(mem_info_t *mem, size_t old_flags, size_t old_request, mem_site_t *site)
+{
+    mem_site_t *old_site = memory_site_of(old_flags);
+    if(old_site != NULL){
+        __atomic_fetch_sub(&old_site->memory_live, old_request, __ATOMIC_RELAXED);
+    }
+
+    mem_site_t *new_site = old_site;
+    size_t index = (old_flags >> MEMORY_SITE_SHIFT) & MEMORY_SITE_MASK;
+    if(site != NULL){
+        index = memory_site_index(site);
+        new_site = (index != 0) ? site : NULL;
+        if(new_site != NULL){
+            __atomic_fetch_add(&site->memory_call, 1, __ATOMIC_RELAXED);
+            if(mem->memory_request > old_request){
+                __atomic_fetch_add(&site->memory_request, mem->memory_request - old_request, __ATOMIC_RELAXED);
+            }
+        }
+    }
+
+    if(new_site != NULL){
+        __atomic_fetch_add(&new_site->memory_live, mem->memory_request, __ATOMIC_RELAXED);
+    }
+    mem->memory_flags = (mem->memory_flags & ~((size_t)(MEMORY_SITE_MASK) << MEMORY_SITE_SHIFT)) | (index << MEMORY_SITE_SHIFT);
+}
+
+/*Снятие живых байт освобождаемого блока с его места*/
+static inline void memory_site_drop(size_t flags, size_t request)
+{
+    mem_site_t *site = memory_site_of(flags);
+    if(site != NULL){
+        __atomic_fetch_sub(&site->memory_live, request, __ATOMIC_RELAXED);
+    }
+}
+#endif /*YAYA_MEMORY_SITE_USE*/
+
+#if YAYA_MEMORY_SAMPLE_USE
+/*Выбранный блок, ключ таблицы - указатель пользователя*/
+typedef struct mem_sample_t {
+    void  *memory_ptr;
+    size_t memory_request;
+    size_t memory_depth;
+    void  *memory_stack[YAYA_MEMORY_SAMPLE_DEPTH];
+}mem_sample_t;
+
+/*Таблица живых выбранных блоков с открытой адресацией, выборки редки и идут под блокировкой*/
+static mem_sample_t memory_sample_table[YAYA_MEMORY_SAMPLE_COUNT];
+static atomic_size_t memory_sample_live = 0;
+static atomic_flag   memory_sample_busy = ATOMIC_FLAG_INIT;
+static atomic_size_t memory_sample_mean = YAYA_MEMORY_SAMPLE_RATE;
+
+/*Байт до следующей выборки в потоке, до первого выделения 0*/
+static _Thread_local intptr_t memory_sample_left = 0;
+static _Thread_local uint64_t memory_sample_seed = 0;
+
+/*Шаг перепроверки среднего при выключенной выборке*/
+#define MEMORY_SAMPLE_IDLE ((intptr_t)(1) << 26)
+
+static inline void memory_sample_lock(void)
+{
+    while(atomic_flag_test_and_set_explicit(&memory_sample_busy, memory_order_acquire)){
+    }
+}
+
+static inline void memory_sample_unlock(void)
+{
+    atomic_flag_clear_explicit(&memory_sample_busy, memory_order_release);
+}
+
+/*Приближенный log2 для x >= 1: порядок числа и многочлен по мантиссе*/
+static inline double memory_sample_log2(double x)
+{
+    uint64_t bits = 0;
+    memcpy(&bits, &x, sizeof(bits));
+    double exp = (double)((int)((bits >> 52) & 0x7FF) - 1023);
+    bits = (bits & 0x000FFFFFFFFFFFFFULL) | 0x3FF0000000000000ULL;
+    double m = 0;
+    memcpy(&m, &bits, sizeof(m));
+    return exp + (m - 1.0) * (1.3465553 - 0.3465553 * (m - 1.0));
+}
+
+/*Шаг до следующей выборки, показательное распределение со средним mean как в tcmalloc*/
+static intptr_t memory_sample_next(size_t mean)
+{
+    if(mean == 0){
+        return MEMORY_SAMPLE_IDLE;
+    }
+    if(memory_sample_seed == 0){
+        memory_sample_seed = (uint64_t)(memory_thread_index()) * 0x9E3779B97F4A7C15ULL;
+    }
+
+    /*xorshift64, 26 старших бит дают q в [1, 2^26]*/
+    memory_sample_seed ^= memory_sample_seed << 13;
+    memory_sample_seed ^= memory_sample_seed >> 7;
+    memory_sample_seed ^= memory_sample_seed << 17;
+    double q = (double)(memory_sample_seed >> 38) + 1.0;
+
+    /*-ln(q / 2^26) * mean*/
+    double step = (26.0 - memory_sample_log2(q)) * 0.6931471805599453 * (double)(mean);
+    return (step < (double)(INTPTR_MAX / 2)) ? (intptr_t)(step) + 1 : INTPTR_MAX / 2;
+}
+
+static inline size_t memory_sample_slot(void *ptr)
+{
+    return (size_t)(((uint64_t)(uintptr_t)(ptr) * 0x9E3779B97F4A7C15ULL) >> 32) & (YAYA_MEMORY_SAMPLE_COUNT - 1);
+}
+
+/*Вставка под блокировкой, таблица заполняется не больше чем на 3/4*/
+static bool memory_sample_insert(mem_sample_t *sample)
+{
+    size_t live = atomic_load_explicit(&memory_sample_live, memory_order_relaxed);
+    if(live >= YAYA_MEMORY_SAMPLE_COUNT / 4 * 3){
+        return false;
+    }
+
+    size_t slot = memory_sample_slot(sample->memory_ptr);
+    while(memory_sample_table[slot].memory_ptr != NULL){
+        slot = (slot + 1) & (YAYA_MEMORY_SAMPLE_COUNT - 1);
+    }
+    memory_sample_table[slot] = *sample;
+    atomic_store_explicit(&memory_sample_live, live + 1, memory_order_relaxed);
+    return true;
+}
+
+/*Удаление под блокировкой со сдвигом следующих записей цепочки назад*/
+static bool memory_sample_erase(void *ptr, mem_sample_t *sample)
+{
+    size_t slot = memory_sample_slot(ptr);
+    while(memory_sample_table[slot].memory_ptr != ptr){
+        if(memory_sample_table[slot].memory_ptr == NULL){
+            return false;
+        }
+        slot = (slot + 1) & (YAYA_MEMORY_SAMPLE_COUNT - 1);
+    }
+    if(sample != NULL){
+        *sample = memory_sample_table[slot];
+    }
+
+    size_t hole = slot;
+    for(;;){
+        slot = (slot + 1) & (YAYA_MEMORY_SAMPLE_COUNT - 1);
+        if(memory_sample_table[slot].memory_ptr == NULL){
+            break;
+        }
+        /*Запись остается, если ее начальная ячейка лежит между дырой и ею самой*/
+        size_t home = memory_sample_slot(memory_sample_table[slot].memory_ptr);
+        if(((slot - home) & (YAYA_MEMORY_SAMPLE_COUNT - 1)) < ((slot - hole) & (YAYA_MEMORY_SAMPLE_COUNT - 1))){
+            continue;
+        }
+        memory_sample_table[hole] = memory_sample_table[slot];
+        hole = slot;
+    }
+    memory_sample_table[hole].memory_ptr = NULL;
+    atomic_fetch_sub_explicit(&memory_sample_live, 1, memory_order_relaxed);
+    return true;
+}
+
+/*Медленная ветка memory_new: счетчик потока исчерпан*/
+__attribute__((noinline, cold))
+static void memory_sample_take(mem_info_t *mem)
+{
+    size_t mean = atomic_load_explicit(&memory_sample_mean, memory_order_relaxed);
+
+    /*Первое выделение потока только заводит счетчик*/
+    if(memory_sample_seed == 0){
+        memory_sample_left = memory_sample_next(mean);
+        return;
+    }
+    memory_sample_left = memory_sample_next(mean);
+    if(mean == 0){
+        return;
+    }
+
+    /*Стек без кадра самой memory_sample_take*/
+    void *stack[YAYA_MEMORY_SAMPLE_DEPTH + 1];
+    int depth = backtrace(stack, YAYA_MEMORY_SAMPLE_DEPTH + 1);
+
+    mem_sample_t sample = {0};
+    sample.memory_ptr = mem->memory_ptr;
+    sample.memory_request = mem->memory_request;
+    sample.memory_depth = (depth > 1) ? (size_t)(depth - 1) : 0;
+    memcpy(sample.memory_stack, stack + 1, sizeof(void*) * sample.memory_depth);
+
+    memory_sample_lock();
+    bool res = memory_sample_insert(&sample);
+    memory_sample_unlock();
+
+    if(res){
+        mem->memory_flags |= MEMORY_FLAG_SAMPLE;
+    }
+}
+
+/*Одна ветка на выделение, при выключенной выборке счетчик тратится медленно*/
+static inline void memory_sample_tick(mem_info_t *mem, size_t len)
+{
+    memory_sample_left -= (intptr_t)(len);
+    if(__builtin_expect(memory_sample_left < 0, 0)){
+        memory_sample_take(mem);
+    }
+}
+
+/*Перенос записи выбранного блока после перераспределения под новый указатель и размер*/
+static void memory_sample_move(mem_info_t *mem, size_t old_flags, void *old_ptr)
+{
+    if(!(old_flags & MEMORY_FLAG_SAMPLE)){
+        return;
+    }
+
+    mem_sample_t sample = {0};
+    memory_sample_lock();
+    bool res = memory_sample_erase(old_ptr, &sample);
+    if(res){
+        sample.memory_ptr = mem->memory_ptr;
+        sample.memory_request = mem->memory_request;
+        res = memory_sample_insert(&sample);
+    }
+    memory_sample_unlock();
+
+    if(res){
+        mem->memory_flags |= MEMORY_FLAG_SAMPLE;
+    }else{
+        mem->memory_flags &= ~(size_t)(MEMORY_FLAG_SAMPLE);
+    }
+}
+
+/*Снятие освобождаемого блока с учета*/
+static inline void memory_sample_drop(size_t flags, void *ptr)
+{
+    if(flags & MEMORY_FLAG_SAMPLE){
+        memory_sample_lock();
+        memory_sample_erase(ptr, NULL);
+        memory_sample_unlock();
+    }
+}
+#endif /*YAYA_MEMORY_SAMPLE_USE*/
+
+#if YAYA_MEMORY_LIVE_USE
+/*Живой блок, ключ таблицы - указатель пользователя*/
+typedef struct mem_live_t {
+    void    *memory_ptr;
+    uint64_t memory_time;  //время выделения в мс
+}mem_live_t;
+
+/*Таблица живых блоков, открытая адресация без блокировок как во внешней таблице сведений*/
+#define MEMORY_LIVE_TOMB ((void*)(uintptr_t)(1))
+
+static mem_live_t memory_live_table[YAYA_MEMORY_LIVE_COUNT];
+static atomic_size_t memory_live_used = 0;
+static atomic_size_t memory_live_lost = 0;
+static size_t memory_live_head = 0;
+
+/*Удаленные записи собираются очисткой как во внешней таблице сведений:
+  занятие идет под счетчиком в memory_live_gate (по 2 на поток), очистка ставит младший бит*/
+static atomic_size_t memory_live_gate;
+static atomic_size_t memory_live_tomb;
+static atomic_size_t memory_live_limit = YAYA_MEMORY_LIVE_COUNT / 4;
+
+/*Грубые часы, для возраста блока хватает точности в несколько мс*/
+static inline uint64_t memory_live_now(void)
+{
+    struct timespec ts;
+#if defined(CLOCK_MONOTONIC_COARSE)
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+#else
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+#endif
+    return (uint64_t)(ts.tv_sec) * 1000U + (uint64_t)(ts.tv_nsec) / 1000000U;
+}
+
+static inline size_t memory_live_hash(const void *ptr)
+{
+    uint64_t key = (uint64_t)((uintptr_t)(ptr) >> 4);
+    return (size_t)((key * 0x9E3779B97F4A7C15ULL) >> 20) & (YAYA_MEMORY_LIVE_COUNT - 1);
+}
+
+/*Занятие свободной или удаленной записи, при заполненной таблице блок не учитывается и считается в memory_live_lost*/
+static void memory_live_insert(void *ptr, uint64_t time)
+{
+    size_t gate = atomic_load_explicit(&memory_live_gate, memory_order_relaxed);
+    for(;;){
+        if(gate & 1){
+            gate = atomic_load_explicit(&memory_live_gate, memory_order_relaxed);
+            continue;
+        }
+        if(atomic_compare_exchange_weak_explicit(&memory_live_gate, &gate, gate + 2, memory_order_acquire, memory_order_relaxed)){
+            break;
+        }
+    }
+
+    bool done = false;
+    size_t hash = memory_live_hash(ptr);
+    for(size_t i = 0; i < YAYA_MEMORY_LIVE_COUNT && !done; i++){
+        mem_live_t *live = &memory_live_table[(hash + i) & (YAYA_MEMORY_LIVE_COUNT - 1)];
+        void *key = __atomic_load_n(&live->memory_ptr, __ATOMIC_ACQUIRE);
+        while(key == NULL || key == MEMORY_LIVE_TOMB){
+            if(__atomic_compare_exchange_n(&live->memory_ptr, &key, ptr, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)){
+                if(key == MEMORY_LIVE_TOMB){
+                    atomic_fetch_sub_explicit(&memory_live_tomb, 1, memory_order_relaxed);
+                }
+                __atomic_store_n(&live->memory_time, time, __ATOMIC_RELAXED);
+                atomic_fetch_add_explicit(&memory_live_used, 1, memory_order_relaxed);
+                done = true;
+                break;
+            }
+        }
+    }
+    if(!done){
+        atomic_fetch_add_explicit(&memory_live_lost, 1, memory_order_relaxed);
+    }
+
+    atomic_fetch_sub_explicit(&memory_live_gate, 2, memory_order_release);
+}
+
+/*Удаленная запись перед свободной становится свободной, проход назад по кругу*/
+static void memory_live_clean(void)
+{
+    size_t gate = 0;
+    if(!atomic_compare_exchange_strong_explicit(&memory_live_gate, &gate, 1, memory_order_acquire, memory_order_relaxed)){
+        return;
+    }
+
+    for(size_t n = 2 * YAYA_MEMORY_LIVE_COUNT; n > 0; n--){
+        size_t i = (n - 1) & (YAYA_MEMORY_LIVE_COUNT - 1);
+        void *next = __atomic_load_n(&memory_live_table[(i + 1) & (YAYA_MEMORY_LIVE_COUNT - 1)].memory_ptr, __ATOMIC_ACQUIRE);
+        void *key  = MEMORY_LIVE_TOMB;
+        if(next == NULL && __atomic_compare_exchange_n(&memory_live_table[i].memory_ptr, &key, NULL, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)){
+            atomic_fetch_sub_explicit(&memory_live_tomb, 1, memory_order_relaxed);
+        }
+    }
+
+    atomic_store_explicit(&memory_live_limit, atomic_load_explicit(&memory_live_tomb, memory_order_relaxed) + YAYA_MEMORY_LIVE_COUNT / 4, memory_order_relaxed);
+    atomic_store_explicit(&memory_live_gate, 0, memory_order_release);
+}
+
+/*Снятие блока с учета, возвращает время выделения или 0*/
+static uint64_t memory_live_erase(void *ptr)
+{
+    size_t hash = memory_live_hash(ptr);
+    for(size_t i = 0; i < YAYA_MEMORY_LIVE_COUNT; i++){
+        mem_live_t *live = &memory_live_table[(hash + i) & (YAYA_MEMORY_LIVE_COUNT - 1)];
+        void *key = __atomic_load_n(&live->memory_ptr, __ATOMIC_ACQUIRE);
+        if(key == ptr){
+            uint64_t time = __atomic_load_n(&live->memory_time, __ATOMIC_RELAXED);
+            __atomic_store_n(&live->memory_ptr, MEMORY_LIVE_TOMB, __ATOMIC_RELEASE);
+            atomic_fetch_sub_explicit(&memory_live_used, 1, memory_order_relaxed);
+            size_t tomb = atomic_fetch_add_explicit(&memory_live_tomb, 1, memory_order_relaxed) + 1;
+            if(tomb > atomic_load_explicit(&memory_live_limit, memory_order_relaxed)){
+                memory_live_clean();
+            }
+            return time;
+        }
+        if(key == NULL){
+            return 0;
+        }
+    }
+    return 0;
+}
+
+/*Перенос записи после перераспределения, возраст блока сохраняется*/
+static void memory_live_move(void *old_ptr, void *new_ptr)
+{
+    if(old_ptr == new_ptr){
+        return;
+    }
+    uint64_t time = memory_live_erase(old_ptr);
+    memory_live_insert(new_ptr, (time != 0) ? time : memory_live_now());
+}
+#endif /*YAYA_MEMORY_LIVE_USE*/
+
+#if YAYA_MEMORY_TAG_USE
+/*Счетчики тегов, номер тега хранится в memory_flags блока*/
+static mem_tag_t memory_tag_table[YAYA_MEMORY_TAG_COUNT];
+
+/*Тег новых блоков в этом потоке*/
+static _Thread_local size_t memory_tag_current = 0;
+
+static inline size_t memory_tag_of(size_t flags)
+{
+    return (flags >> MEMORY_TAG_SHIFT) & MEMORY_TAG_MASK;
+}
+
+static inline void memory_tag_mark(mem_info_t *mem, size_t tag)
+{
+    mem->memory_flags = (mem->memory_flags & ~((size_t)(MEMORY_TAG_MASK) << MEMORY_TAG_SHIFT)) | (tag << MEMORY_TAG_SHIFT);
+}
+
+/*Учет request байт под тег до выделения, false при превышении жесткого бюджета.
+  Сверх мягкого бюджета вызывается обработчик, выделение продолжается*/
+static bool memory_tag_take(size_t tag, size_t request)
+{
+    mem_tag_t *info = &memory_tag_table[tag];
+    size_t live = __atomic_add_fetch(&info->memory_live, request, __ATOMIC_RELAXED);
+
+    size_t hard = __atomic_load_n(&info->memory_hard, __ATOMIC_RELAXED);
+    if(hard != 0 && live > hard){
+        __atomic_fetch_sub(&info->memory_live, request, __ATOMIC_RELAXED);
+        __atomic_fetch_add(&info->memory_fail, 1, __ATOMIC_RELAXED);
+        return false;
+    }
+
+    size_t soft = __atomic_load_n(&info->memory_soft, __ATOMIC_RELAXED);
+    if(soft != 0 && live > soft){
+        mem_tag_fn_t callback = __atomic_load_n(&info->memory_callback, __ATOMIC_ACQUIRE);
+        if(callback != NULL){
+            callback(tag, live, request);
+        }
+    }
+
+    __atomic_fetch_add(&info->memory_call, 1, __ATOMIC_RELAXED);
+    return true;
+}
+
+static inline void memory_tag_give(size_t tag, size_t request)
+{
+    __atomic_fetch_sub(&memory_tag_table[tag].memory_live, request, __ATOMIC_RELAXED);
+}
+#endif /*YAYA_MEMORY_TAG_USE*/
+
+#if YAYA_MEMORY_CHECK_USE || YAYA_MEMORY_QUARANTINE_USE
+/*Смещение первого байта, отличного от YAYA_MEMORY_VALUE_AFTER_MEM, или len*/
+static size_t memory_poison_find(const uint8_t *p, size_t len)
+{
+    size_t i = 0;
+
+#if defined(__SSE2__)
+    const __m128i fill = _mm_set1_epi8((char)(YAYA_MEMORY_VALUE_AFTER_MEM));
+    for(; i + 64 <= len; i += 64){
+        __m128i a = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(p + i) + 0), fill);
+        __m128i b = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(p + i) + 1), fill);
+        __m128i c = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(p + i) + 2), fill);
+        __m128i d = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(p + i) + 3), fill);
+        if(_mm_movemask_epi8(_mm_and_si128(_mm_and_si128(a, b), _mm_and_si128(c, d))) != 0xFFFF){
+            break;
+        }
+    }
+    for(; i + 16 <= len; i += 16){
+        int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(p + i)), fill));
+        if(mask != 0xFFFF){
+            return i + (size_t)(__builtin_ctz((unsigned)(~mask) & 0xFFFFU));
+        }
+    }
+#else
+    const uint64_t fill = 0x0101010101010101ULL * (uint8_t)(YAYA_MEMORY_VALUE_AFTER_MEM);
+    for(; i + 8 <= len; i += 8){
+        uint64_t word = 0;
+        memcpy(&word, p + i, sizeof(word));
+        if(word != fill){
+            break;
+        }
+    }
+#endif
+
+    for(; i < len; i++){
+        if(p[i] != (uint8_t)(YAYA_MEMORY_VALUE_AFTER_MEM)){
+            return i;
+        }
+    }
+    return len;
+}
+#endif /*YAYA_MEMORY_QUARANTINE_USE*/
+
+#if YAYA_MEMORY_CHECK_USE
+/*Проверка хвоста блока с отчетом о порче*/
+static bool memory_check_block(mem_info_t *mem)
+{
+    size_t tail = memory_info_produce(mem) - MEMORY_INFO_SIZE - mem->memory_request;
+#if YAYA_MEMORY_CHECK_SIZE
+    tail = (tail < YAYA_MEMORY_CHECK_SIZE) ? tail : YAYA_MEMORY_CHECK_SIZE;
+#endif
+
+    size_t offset = memory_poison_find(mem->memory_ptr + mem->memory_request, tail);
+    if(offset == tail){
+        return true;
+    }
+
+    printf("OVERRUN: %p; ", (void*)(mem->memory_ptr));
+    printf("Request:%10zu; ", mem->memory_request);
+    printf("Offset:%10zu; ", mem->memory_request + offset);
+#if YAYA_MEMORY_SITE_USE
+    mem_site_t *site = memory_site_of(memory_info_flags(mem));
+    if(site != NULL){
+        printf("%s:%zu %s", site->memory_file, site->memory_line, site->memory_func);
+    }
+#endif
+    printf("\n");
+
+    /*Хвост с первого испорченного байта*/
+    size_t len = tail - offset;
+    memory_dump(mem->memory_ptr + mem->memory_request + offset, (len < 32) ? len : 32, 1, 16);
+    fflush(stdout);
+
+#if YAYA_MEMORY_CHECK_ABORT
+    abort();
+#endif
+    return false;
+}
+#endif /*YAYA_MEMORY_CHECK_USE*/
+
+/*Выделение блока под запрос с заголовком, зануление и заполнение хвоста*/
+static mem_info_t *memory_block_new(const size_t new_size_len)
+{
+    mem_info_t *mem = NULL;
+    size_t produce = 0;
+    size_t flags = MEMORY_KIND_HEAP;
+
+#if YAYA_MEMORY_SLAB_USE
+    size_t slab_class = memory_slab_find(new_size_len);
+    if(slab_class < MEMORY_SLAB_COUNT){
+        mem = memory_slab_pop(slab_class);
+        produce = memory_slab_block(slab_class);
+        flags = MEMORY_KIND_SLAB | (slab_class << MEMORY_CLASS_SHIFT);
+    }
+#endif
+
+#if YAYA_MEMORY_MMAP_USE
+    /*Страницы от ядра уже занулены и не трогаются до записи*/
+    bool zeroed = false;
+#if YAYA_MEMORY_HUGE_USE
+    if(flags == MEMORY_KIND_HEAP && new_size_len + sizeof(mem_info_t) >= YAYA_MEMORY_HUGE_SIZE){
+        size_t huge = memory_huge_round(new_size_len + sizeof(mem_info_t));
+        size_t huge_flags = MEMORY_KIND_MMAP | MEMORY_FLAG_HUGE;
+        mem = memory_huge_map(huge, &huge_flags);
+        if(mem != NULL){
+            produce = huge;
+            flags = huge_flags;
+            zeroed = true;
+        }
+    }
+#endif
+#if YAYA_MEMORY_CHECK_GUARD
+    /*Конец блока вплотную к странице без доступа, между ними меньше max_align_t.
+      Блоки на больших страницах остаются без защиты, при отказе mmap или mprotect блок без защиты*/
+    if(flags == MEMORY_KIND_HEAP && new_size_len + sizeof(mem_info_t) >= YAYA_MEMORY_MMAP_SIZE){
+        size_t page = memory_page_round(1);
+        size_t body = (new_size_len + alignof(max_align_t) - 1) & ~(alignof(max_align_t) - 1);
+        size_t span = memory_page_round(body + sizeof(mem_info_t));
+        void *map = mmap(NULL, span + page, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if(map != MAP_FAILED){
+            if(mprotect((uint8_t*)(map) + span, page, PROT_NONE) == 0){
+                mem = (mem_info_t*)((uint8_t*)(map) + span - body - sizeof(mem_info_t));
+                produce = body + sizeof(mem_info_t);
+                flags = MEMORY_KIND_MMAP | MEMORY_FLAG_GUARD;
+                zeroed = true;
+            }else{
+                munmap(map, span + page);
+            }
+        }
+    }
+#endif
+    if(flags == MEMORY_KIND_HEAP && new_size_len + sizeof(mem_info_t) >= YAYA_MEMORY_MMAP_SIZE){
+        produce = memory_page_round(new_size_len + sizeof(mem_info_t));
+        void *map = mmap(NULL, produce, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        mem = (map != MAP_FAILED) ? map : NULL;
+        flags = MEMORY_KIND_MMAP;
+        zeroed = true;
+    }
+#endif
+
+    if(flags == MEMORY_KIND_HEAP){
+        void *base = malloc(new_size_len + MEMORY_INFO_SIZE);
+        if(base != NULL){
+            produce = malloc_usable_size(base);
+            mem = memory_info_bind(base);
+            if(mem == NULL){
+                free(base);
+            }
+        }
+    }
+
+    /*Проверка, что память выделилась*/
+    if(mem == NULL){
+        return NULL;
+    }
+
+    /*Зануление всего запрошеного и заполнение хвоста*/
+#if YAYA_MEMORY_MMAP_USE
+    if(!zeroed)
+#endif
+    memset(mem->memory_ptr, 0x00, new_size_len);
+    memset(mem->memory_ptr + new_size_len, YAYA_MEMORY_VALUE_AFTER_MEM, produce - (new_size_len + MEMORY_INFO_SIZE));
+
+    /*Сохранение информации о количестве памяти*/
+    mem->memory_request = new_size_len;
+    memory_info_produce_set(mem, produce);
+#if YAYA_MEMORY_INFO_FLAGS
+    mem->memory_flags = flags;
+#endif
+
+    return mem;
+}
+
+#if YAYA_MEMORY_ALIGN_USE
+/*Отступ начала памяти пользователя от начала выделенного, кратный align*/
+static inline size_t memory_align_front(size_t align)
+{
+    return (sizeof(mem_info_t) + align - 1) & ~(align - 1);
+}
+
+/*Выделение блока с выравниванием памяти пользователя на align байт,
+  заголовок лежит вплотную перед памятью пользователя*/
+static mem_info_t *memory_block_align(const size_t new_size_len, size_t align)
+{
+    size_t front = memory_align_front(align);
+    void *base = NULL;
+
+    if(posix_memalign(&base, align, front + new_size_len) != 0){
+        return NULL;
+    }
+
+    mem_info_t *mem = (mem_info_t*)((uint8_t*)(base) + front - sizeof(mem_info_t));
+    size_t produce = malloc_usable_size(base) - (front - sizeof(mem_info_t));
+
+    /*Зануление всего запрошеного и заполнение хвоста*/
+    memset(mem, 0x00, new_size_len + sizeof(mem_info_t));
+    memset(mem->memory_ptr + new_size_len, YAYA_MEMORY_VALUE_AFTER_MEM, produce - (new_size_len + sizeof(mem_info_t)));
+
+    /*Сохранение информации о количестве памяти и степени выравнивания*/
+    mem->memory_request = new_size_len;
+    mem->memory_produce = produce;
+    mem->memory_flags   = MEMORY_KIND_ALIGN | ((size_t)(__builtin_ctzll(align)) << MEMORY_CLASS_SHIFT);
+
+    return mem;
+}
+#endif /*YAYA_MEMORY_ALIGN_USE*/
+
+/*Возврат блока источнику, флаги читаются до затирания заголовка*/
+static void memory_block_del(void *block, size_t flags, size_t produce)
+{
+#if YAYA_MEMORY_CHECK_GUARD
+    /*Отображение начинается со страницы заголовка и кончается страницей защиты*/
+    if(flags & MEMORY_FLAG_GUARD){
+        size_t page = memory_page_round(1);
+        uint8_t *map = (uint8_t*)((uintptr_t)(block) & ~(uintptr_t)(page - 1));
+        munmap(map, (size_t)((uint8_t*)(block) + produce - map) + page);
+        return;
+    }
+#endif
+#if YAYA_MEMORY_MMAP_USE
+    if((flags & MEMORY_KIND_MASK) == MEMORY_KIND_MMAP){
+        munmap(block, produce);
+        return;
+    }
+#endif
+#if YAYA_MEMORY_SLAB_USE
+    if((flags & MEMORY_KIND_MASK) == MEMORY_KIND_SLAB){
+        memory_slab_push((flags >> MEMORY_CLASS_SHIFT) & MEMORY_CLASS_MASK, block);
+        return;
+    }
+#endif
+#if YAYA_MEMORY_ALIGN_USE
+    if((flags & MEMORY_KIND_MASK) == MEMORY_KIND_ALIGN){
+        size_t front = memory_align_front((size_t)(1) << ((flags >> MEMORY_CLASS_SHIFT) & MEMORY_CLASS_MASK));
+        free((uint8_t*)(block) + sizeof(mem_info_t) - front);
+        return;
+    }
+#endif
+    (void)(flags);
+    (void)(produce);
+    free(block);
+}
+
+/*Затирание блока перед возвратом при YAYA_MEMORY_FILL_NULL_AFTER_FREE.
+  Страницы mmap сразу уходят ядру, затирание только подняло бы нетронутые*/
+static inline void memory_block_wipe(void *base, size_t flags, size_t produce)
+{
+#if YAYA_MEMORY_FILL_NULL_AFTER_FREE
+    if((flags & MEMORY_KIND_MASK) != MEMORY_KIND_MMAP){
+        memory_wipe(base, YAYA_MEMORY_VALUE_AFTER_MEM, produce);
+    }
+#else
+    (void)(base);
+    (void)(flags);
+    (void)(produce);
+#endif
+}
+
+#if YAYA_MEMORY_QUARANTINE_USE
+/*Затертый блок в очереди, заголовок уже затерт и сведения хранятся здесь*/
+typedef struct mem_quarantine_item_t {
+    void  *memory_base;
+    size_t memory_flags;
+    size_t memory_produce;
+}mem_quarantine_item_t;
+
+/*Кольцо FIFO одного потока*/
+typedef struct mem_quarantine_t {
+    size_t memory_head;
+    size_t memory_count;
+    size_t memory_bytes;
+    mem_quarantine_item_t memory_item[YAYA_MEMORY_QUARANTINE_COUNT];
+}mem_quarantine_t;
+
+static _Thread_local mem_quarantine_t *memory_quarantine_local = NULL;
+static pthread_key_t  memory_quarantine_key;
+static pthread_once_t memory_quarantine_once = PTHREAD_ONCE_INIT;
+
+/*Выход старейшего блока: проверка затирания и возврат источнику*/
+static bool memory_quarantine_pop(mem_quarantine_t *quarantine)
+{
+    mem_quarantine_item_t item = quarantine->memory_item[quarantine->memory_head];
+    quarantine->memory_head = (quarantine->memory_head + 1) % YAYA_MEMORY_QUARANTINE_COUNT;
+    quarantine->memory_count--;
+    quarantine->memory_bytes -= item.memory_produce;
+
+    size_t offset = memory_poison_find(item.memory_base, item.memory_produce);
+    bool res = (offset == item.memory_produce);
+    if(!res){
+        printf("USE AFTER FREE: %p; ", item.memory_base);
+        printf("Produce:%10zu; ", item.memory_produce);
+        printf("Offset:%10zu", offset);
+        printf("\n");
+
+        size_t len = item.memory_produce - offset;
+        memory_dump((uint8_t*)(item.memory_base) + offset, (len < 32) ? len : 32, 1, 16);
+        fflush(stdout);
+#if YAYA_MEMORY_CHECK_ABORT
+        abort();
+#endif
+    }
+
+    memory_block_del(item.memory_base, item.memory_flags, item.memory_produce);
+    return res;
+}
+
+static bool memory_quarantine_drain(mem_quarantine_t *quarantine)
+{
+    bool res = true;
+    while(quarantine->memory_count != 0){
+        res &= memory_quarantine_pop(quarantine);
+    }
+    return res;
+}
+
+/*При завершении потока очередь освобождается*/
+static void memory_quarantine_exit(void *ptr)
+{
+    memory_quarantine_local = NULL;
+    memory_quarantine_drain(ptr);
+    free(ptr);
+}
+
+static void memory_quarantine_key_init(void)
+{
+    pthread_key_create(&memory_quarantine_key, memory_quarantine_exit);
+}
+
+/*Постановка затертого блока в очередь за O(1), старые блоки вытесняются по объему и числу.
+  Блоки больше всей очереди освобождаются сразу*/
+static void memory_quarantine_push(void *base, size_t flags, size_t produce)
+{
+    mem_quarantine_t *quarantine = memory_quarantine_local;
+    if(quarantine == NULL && produce <= YAYA_MEMORY_QUARANTINE_SIZE){
+        quarantine = calloc(1, sizeof(mem_quarantine_t));
+        if(quarantine != NULL){
+            pthread_once(&memory_quarantine_once, memory_quarantine_key_init);
+            pthread_setspecific(memory_quarantine_key, quarantine);
+            memory_quarantine_local = quarantine;
+        }
+    }
+    if(quarantine == NULL || produce > YAYA_MEMORY_QUARANTINE_SIZE){
+        memory_block_wipe(base, flags, produce);
+        memory_block_del(base, flags, produce);
+        return;
+    }
+
+    /*Затирается только блок, который остается в очереди и проверяется при выходе*/
+    memory_wipe(base, YAYA_MEMORY_VALUE_AFTER_MEM, produce);
+
+    while(quarantine->memory_count == YAYA_MEMORY_QUARANTINE_COUNT || quarantine->memory_bytes + produce > YAYA_MEMORY_QUARANTINE_SIZE){
+        memory_quarantine_pop(quarantine);
+    }
+
+    size_t tail = (quarantine->memory_head + quarantine->memory_count) % YAYA_MEMORY_QUARANTINE_COUNT;
+    quarantine->memory_item[tail] = (mem_quarantine_item_t){base, flags, produce};
+    quarantine->memory_count++;
+    quarantine->memory_bytes += produce;
+}
+#endif /*YAYA_MEMORY_QUARANTINE_USE*/
+
+/*Емкость при росте блока с запасом YAYA_MEMORY_GROWTH процентов*/
+static inline size_t memory_grow(size_t old_size, size_t new_size)
+{
+    size_t grow = old_size + (old_size / 100) * YAYA_MEMORY_GROWTH + (old_size % 100) * YAYA_MEMORY_GROWTH / 100;
+    return (grow > new_size) ? grow : new_size;
+}
+
+/*Перераспределение блока под capacity байт, поле memory_produce обновляется,
+  в dirty граница от начала блока, за которой память уже занулена*/
+static mem_info_t *memory_block_res(mem_info_t *mem_old, const size_t new_size_len, const size_t capacity, size_t *dirty)
+{
+    mem_info_t *mem_new = NULL;
+
+#if YAYA_MEMORY_ARENA_USE
+    /*Блоки арены перераспределяются через memory_arena_new*/
+    if((memory_info_flags(mem_old) & MEMORY_KIND_MASK) == MEMORY_KIND_ARENA){
+        return NULL;
+    }
+#endif
+
+#if YAYA_MEMORY_SLAB_USE
+    if((memory_info_flags(mem_old) & MEMORY_KIND_MASK) == MEMORY_KIND_SLAB){
+        /*Запрос помещается в текущий блок*/
+        if(capacity + sizeof(mem_info_t) <= mem_old->memory_produce){
+            *dirty = mem_old->memory_produce;
+            return mem_old;
+        }
+
+        /*Перенос в блок большего класса или в кучу*/
+        mem_new = memory_block_new(capacity);
+        if(mem_new == NULL){
+            return NULL;
+        }
+        memcpy(mem_new->memory_ptr, mem_old->memory_ptr, mem_old->memory_request);
+        memory_block_del(mem_old, memory_info_flags(mem_old), mem_old->memory_produce);
+        *dirty = mem_new->memory_produce;
+        return mem_new;
+    }
+#endif
+
+#if YAYA_MEMORY_ALIGN_USE
+    if((memory_info_flags(mem_old) & MEMORY_KIND_MASK) == MEMORY_KIND_ALIGN){
+        /*Сжатие на месте*/
+        if(capacity + sizeof(mem_info_t) <= mem_old->memory_produce){
+            *dirty = mem_old->memory_produce;
+            return mem_old;
+        }
+
+        /*Перенос в новый блок с тем же выравниванием*/
+        mem_new = memory_block_align(capacity, (size_t)(1) << ((memory_info_flags(mem_old) >> MEMORY_CLASS_SHIFT) & MEMORY_CLASS_MASK));
+        if(mem_new == NULL){
+            return NULL;
+        }
+        memcpy(mem_new->memory_ptr, mem_old->memory_ptr, mem_old->memory_request);
+        memory_block_del(mem_old, memory_info_flags(mem_old), mem_old->memory_produce);
+        *dirty = mem_new->memory_produce;
+        return mem_new;
+    }
+#endif
+
+#if YAYA_MEMORY_CHECK_GUARD
+    /*Конец блока привязан к странице защиты, при смене размера блок переезжает целиком*/
+    if(memory_info_flags(mem_old) & MEMORY_FLAG_GUARD){
+        size_t body = (new_size_len + alignof(max_align_t) - 1) & ~(alignof(max_align_t) - 1);
+        if(body + sizeof(mem_info_t) == mem_old->memory_produce){
+            *dirty = mem_old->memory_produce;
+            return mem_old;
+        }
+
+        mem_new = memory_block_new(new_size_len);
+        if(mem_new == NULL){
+            return NULL;
+        }
+        size_t copy = (mem_old->memory_request < new_size_len) ? mem_old->memory_request : new_size_len;
+        memcpy(mem_new->memory_ptr, mem_old->memory_ptr, copy);
+        memory_block_del(mem_old, memory_info_flags(mem_old), mem_old->memory_produce);
+        *dirty = sizeof(mem_info_t) + copy;
+        return mem_new;
+    }
+#endif
+
+#if YAYA_MEMORY_HUGE_USE
+    /*Страницы hugetlbfs не переносятся через mremap, блок переезжает целиком*/
+    if(memory_info_flags(mem_old) & MEMORY_FLAG_HUGETLB){
+        if(new_size_len + sizeof(mem_info_t) <= mem_old->memory_produce){
+            *dirty = mem_old->memory_produce;
+            return mem_old;
+        }
+
+        mem_new = memory_block_new(new_size_len);
+        if(mem_new == NULL){
+            return NULL;
+        }
+        memcpy(mem_new->memory_ptr, mem_old->memory_ptr, mem_old->memory_request);
+        *dirty = sizeof(mem_info_t) + mem_old->memory_request;
+        memory_block_del(mem_old, memory_info_flags(mem_old), mem_old->memory_produce);
+        return mem_new;
+    }
+#endif
+
+#if YAYA_MEMORY_MMAP_USE
+    if((memory_info_flags(mem_old) & MEMORY_KIND_MASK) == MEMORY_KIND_MMAP){
+        size_t old_size_p = mem_old->memory_produce;
+        size_t new_size_p = memory_page_round(new_size_len + sizeof(mem_info_t));
+#if YAYA_MEMORY_HUGE_USE
+        if(memory_info_flags(mem_old) & MEMORY_FLAG_HUGE){
+            new_size_p = memory_huge_round(new_size_len + sizeof(mem_info_t));
+        }
+#endif
+
+        /*Перенос страниц без копирования, новые страницы занулены*/
+        mem_new = mem_old;
+        if(new_size_p != old_size_p){
+#if YAYA_MEMORY_HUGE_USE
+            if(memory_info_flags(mem_old) & MEMORY_FLAG_HUGE){
+                mem_new = memory_huge_move(mem_old, old_size_p, new_size_p);
+                if(mem_new == NULL){
+                    return NULL;
+                }
+            }else
+#endif
+            {
+                void *map = mremap(mem_old, old_size_p, new_size_p, MREMAP_MAYMOVE);
+                if(map == MAP_FAILED){
+                    return NULL;
+                }
+                mem_new = map;
+            }
+        }
+        mem_new->memory_produce = new_size_p;
+        *dirty = (old_size_p < new_size_p) ? old_size_p : new_size_p;
+        return mem_new;
+    }
+#endif
+
+#if YAYA_MEMORY_INFO_MODE == 2
+    /*Новый ключ занимается, пока старый блок жив: адрес не может достаться другому потоку,
+      а при отказе старый блок остается нетронутым*/
+    void *base = malloc(capacity);
+    if(base == NULL){
+        return NULL;
+    }
+    mem_new = memory_info_bind(base);
+    if(mem_new == NULL){
+        free(base);
+        return NULL;
+    }
+    void *old_base = mem_old->memory_ptr;
+    memcpy(base, old_base, (mem_old->memory_request < capacity) ? mem_old->memory_request : capacity);
+    mem_new->memory_request = mem_old->memory_request;
+    memory_info_unbind(mem_old);
+    free(old_base);
+#else
+    void *base = realloc(memory_info_base(mem_old), capacity + MEMORY_INFO_SIZE);
+    if(base == NULL){
+        return NULL;
+    }
+    mem_new = base;
+#endif
+    *dirty = malloc_usable_size(base);
+    memory_info_produce_set(mem_new, *dirty);
+
+    return mem_new;
+}
+
+bool memory_new(
+        #if YAYA_MEMORY_STATS_USE
+        mem_stats_t *mem_stats,
+        #endif
+        void **ptr,
+        void *old_ptr,
+        const size_t count,
+        const size_t size)
+{
+#if YAYA_MEMORY_STATS_USE && YAYA_MEMORY_STATS_OFF
+    (void)(mem_stats);
+#endif
+    MEMORY_LATENCY_SCOPE((old_ptr == NULL) ? MEMORY_LATENCY_NEW : MEMORY_LATENCY_RES);
+
+    /*Указатели под структуру памяти*/
+    mem_info_t *mem_old = {0};
+    mem_info_t *mem_new = {0};
+
+    /*Проверка, что запрошено не нулевой размер памяти*/
+    const size_t new_size_len = (count * size);
+    if(new_size_len == 0){
+        return false;
+    }
+
+    /*Проверка, что возвращать есть куда*/
+    if(ptr == NULL){
+        return false;
+    }
+
+    /*Если память не инициализирована, то указатель на предыдущую память NULL*/
+    if(old_ptr == NULL){
+#if YAYA_MEMORY_TAG_USE
+        /*Бюджет тега проверяется до выделения*/
+        size_t tag = memory_tag_current;
+        if(!memory_tag_take(tag, new_size_len)){
+            return false;
+        }
+#endif
+
+        /*Выделение памяти под запрос и на хранение информации и указателя*/
+        mem_new = memory_block_new(new_size_len);
+
+        /*Проверка, что память выделилась*/
+        if(mem_new == NULL){
+#if YAYA_MEMORY_TAG_USE
+            memory_tag_give(tag, new_size_len);
+#endif
+            return false;
+        }
+
+#if YAYA_MEMORY_TAG_USE
+        memory_tag_mark(mem_new, tag);
+#endif
+
+        /*Возвращение указателя на память для пользователя*/
+        *ptr = mem_new->memory_ptr;
+
+#if YAYA_MEMORY_SITE_USE
+        memory_site_move(mem_new, 0, 0, memory_site_current);
+#endif
+
+#if YAYA_MEMORY_SAMPLE_USE
+        memory_sample_tick(mem_new, new_size_len);
+#endif
+#if YAYA_MEMORY_LIVE_USE
+        memory_live_insert(mem_new->memory_ptr, memory_live_now());
+#endif
+
+#if YAYA_MEMORY_STATS_USE && !YAYA_MEMORY_STATS_OFF
+        /*Сохранение статистики*/
+        if(mem_stats != NULL){
+            MEMORY_STATS_ADD(mem_stats, memory_call_new, 1);
+            MEMORY_STATS_ADD(mem_stats, memory_request, mem_new->memory_request);
+            MEMORY_STATS_PRODUCE(mem_stats, memory_info_produce(mem_new));
+            MEMORY_STATS_ADD(mem_stats, memory_header, sizeof(mem_info_t));
+#if YAYA_MEMORY_HUGE_USE
+            MEMORY_STATS_ADD(mem_stats, memory_huge, memory_huge_size(memory_info_flags(mem_new), mem_new->memory_produce));
+#endif
+            MEMORY_STATS_ADD(mem_stats, memory_hist_sum, new_size_len);
+            MEMORY_STATS_ADD(mem_stats, memory_hist_request[memory_stats_bucket(new_size_len)], 1);
+            memory_stats_live(mem_stats, 0, new_size_len);
+            memory_stats_peak(mem_stats);
+        }
+#endif
+    }
+    /*Если память инициализированна, то указатель на предыдущую память не NULL*/
+    else
+    {
+        /*Помещаем указатель со смещением*/
+        mem_old = memory_info(old_ptr);
+        if(mem_old == NULL){
+            return false;
+        }
+
+        /*Запоминаем сколько было выделено и сколько запрошено*/
+        size_t old_size_r = mem_old->memory_request;
+        size_t old_size_p = memory_info_produce(mem_old);
+#if YAYA_MEMORY_SITE_USE || YAYA_MEMORY_SAMPLE_USE || YAYA_MEMORY_TAG_USE
+        size_t old_flags = memory_info_flags(mem_old);
+#endif
+#if YAYA_MEMORY_HUGE_USE
+        size_t old_size_h = memory_huge_size(memory_info_flags(mem_old), old_size_p);
+#endif
+
+#if YAYA_MEMORY_TAG_USE
+        /*Рост учитывается по тегу самого блока*/
+        size_t tag = memory_tag_of(old_flags);
+        if(new_size_len > old_size_r && !memory_tag_take(tag, new_size_len - old_size_r)){
+            return false;
+        }
+#endif
+
+        /*Рост или тот же размер в пределах уже выделенного, хвост заполнен YAYA_MEMORY_VALUE_AFTER_MEM.
+          Тот же размер не перераспределяется, чтобы не потерять запас memory_reserve*/
+        if(new_size_len >= old_size_r && new_size_len + MEMORY_INFO_SIZE <= old_size_p
+#if YAYA_MEMORY_ARENA_USE
+           && (memory_info_flags(mem_old) & MEMORY_KIND_MASK) != MEMORY_KIND_ARENA
+#endif
+          ){
+            memset(mem_old->memory_ptr + old_size_r, 0x00, new_size_len - old_size_r);
+            mem_old->memory_request = new_size_len;
+            *ptr = mem_old->memory_ptr;
+
+#if YAYA_MEMORY_SITE_USE
+            memory_site_move(mem_old, old_flags, old_size_r, memory_site_current);
+#endif
+#if YAYA_MEMORY_SAMPLE_USE
+            memory_sample_move(mem_old, old_flags, old_ptr);
+#endif
+
+#if YAYA_MEMORY_STATS_USE && !YAYA_MEMORY_STATS_OFF
+            /*Сохранение статистики*/
+            if(mem_stats != NULL){
+                MEMORY_STATS_ADD(mem_stats, memory_call_res, 1);
+                MEMORY_STATS_ADD(mem_stats, memory_request, new_size_len - old_size_r);
+                MEMORY_STATS_ADD(mem_stats, memory_hist_sum, new_size_len);
+                MEMORY_STATS_ADD(mem_stats, memory_hist_request[memory_stats_bucket(new_size_len)], 1);
+                memory_stats_live(mem_stats, old_size_r, new_size_len);
+            }
+#endif
+            return true;
+        }
+
+        /*Перераспределяем память, при росте с запасом*/
+        size_t dirty = 0;
+        size_t capacity = (new_size_len > old_size_r) ? memory_grow(old_size_r, new_size_len) : new_size_len;
+        mem_new = memory_block_res(mem_old, new_size_len, capacity, &dirty);
+
+        /*Проверка, что память выделилась*/
+        if(mem_new == NULL){
+#if YAYA_MEMORY_TAG_USE
+            if(new_size_len > old_size_r){
+                memory_tag_give(tag, new_size_len - old_size_r);
+            }
+#endif
+            return false;
+        }
+
+#if YAYA_MEMORY_TAG_USE
+        /*Блок мог переехать в новый заголовок*/
+        memory_tag_mark(mem_new, tag);
+        if(new_size_len < old_size_r){
+            memory_tag_give(tag, old_size_r - new_size_len);
+        }
+#endif
+
+        /*Запоминаем сколько выделено и сколько запрошено*/
+        size_t new_size_p = memory_info_produce(mem_new);
+        size_t new_size_r = new_size_len;
+
+        /*Вычисление разницы*/
+        intptr_t diff_r = (intptr_t)(new_size_r) - (intptr_t)(old_size_r);
+#if YAYA_MEMORY_STATS_USE && !YAYA_MEMORY_STATS_OFF
+        intptr_t diff_p = (intptr_t)(new_size_p) - (intptr_t)(old_size_p);
+#endif
+        /*Зануление добавленного и заполнение хвоста выделенного*/
+        if(diff_r > 0){
+            size_t end = dirty - MEMORY_INFO_SIZE;
+            end = (end < new_size_r) ? end : new_size_r;
+            memset(mem_new->memory_ptr + old_size_r, 0x00, end - old_size_r);
+        }
+        memset(mem_new->memory_ptr + new_size_r, YAYA_MEMORY_VALUE_AFTER_MEM, new_size_p - MEMORY_INFO_SIZE - new_size_r);
+
+        /*Сохранение информации о количестве запрощеной памяти*/
+        mem_new->memory_request = new_size_r;
+
+        /*Возвращение указателя на память для пользователя*/
+        *ptr = mem_new->memory_ptr;
+
+#if YAYA_MEMORY_SITE_USE
+        memory_site_move(mem_new, old_flags, old_size_r, memory_site_current);
+#endif
+#if YAYA_MEMORY_SAMPLE_USE
+        memory_sample_move(mem_new, old_flags, old_ptr);
+#endif
+#if YAYA_MEMORY_LIVE_USE
+        memory_live_move(old_ptr, mem_new->memory_ptr);
+#endif
+
+#if YAYA_MEMORY_STATS_USE && !YAYA_MEMORY_STATS_OFF
+        /*Сохранение статистики*/
+        if(mem_stats != NULL){
+            MEMORY_STATS_ADD(mem_stats, memory_call_res, 1);
+            MEMORY_STATS_ADD(mem_stats, memory_request, (size_t)(diff_r));
+            MEMORY_STATS_PRODUCE(mem_stats, (size_t)(diff_p));
+#if YAYA_MEMORY_HUGE_USE
+            MEMORY_STATS_ADD(mem_stats, memory_huge, memory_huge_size(memory_info_flags(mem_new), new_size_p) - old_size_h);
+#endif
+            MEMORY_STATS_ADD(mem_stats, memory_hist_sum, new_size_r);
+            MEMORY_STATS_ADD(mem_stats, memory_hist_request[memory_stats_bucket(new_size_r)], 1);
+            memory_stats_live(mem_stats, old_size_r, new_size_r);
+            memory_stats_peak(mem_stats);
+        }
+#endif
+    }
+    return true;
+}
+
+#if YAYA_MEMORY_ALIGN_USE
+bool memory_new_aligned(
+        #if YAYA_MEMORY_STATS_USE
+        mem_stats_t *mem_stats,
+        #endif
+        void **ptr,
+        const size_t count,
+        const size_t size,
+        const size_t align)
+{
+#if YAYA_MEMORY_STATS_USE && YAYA_MEMORY_STATS_OFF
+    (void)(mem_stats);
+#endif
+    MEMORY_LATENCY_SCOPE(MEMORY_LATENCY_NEW);
+
+    /*Проверка, что запрошено не нулевой размер памяти*/
+    const size_t new_size_len = (count * size);
+    if(new_size_len == 0){
+        return false;
+    }
+
+    /*Проверка, что возвращать есть куда*/
+    if(ptr == NULL){
+        return false;
+    }
+
+    /*Проверка, что выравнивание есть степень 2*/
+    if(align == 0 || (align & (align - 1)) != 0){
+        return false;
+    }
+
+#if YAYA_MEMORY_TAG_USE
+    size_t tag = memory_tag_current;
+    if(!memory_tag_take(tag, new_size_len)){
+        return false;
+    }
+#endif
+
+    /*Выравнивание max_align_t дает любой блок*/
+    mem_info_t *mem_new = NULL;
+    if(align <= alignof(max_align_t)){
+        mem_new = memory_block_new(new_size_len);
+    }else{
+        mem_new = memory_block_align(new_size_len, align);
+    }
+
+    /*Проверка, что память выделилась*/
+    if(mem_new == NULL){
+#if YAYA_MEMORY_TAG_USE
+        memory_tag_give(tag, new_size_len);
+#endif
+        return false;
+    }
+
+#if YAYA_MEMORY_TAG_USE
+    memory_tag_mark(mem_new, tag);
+#endif
+
+    /*Возвращение указателя на память для пользователя*/
+    *ptr = mem_new->memory_ptr;
+
+#if YAYA_MEMORY_SAMPLE_USE
+    memory_sample_tick(mem_new, new_size_len);
+#endif
+#if YAYA_MEMORY_LIVE_USE
+    memory_live_insert(mem_new->memory_ptr, memory_live_now());
+#endif
+
+#if YAYA_MEMORY_STATS_USE && !YAYA_MEMORY_STATS_OFF
+    /*Сохранение статистики*/
+    if(mem_stats != NULL){
+        MEMORY_STATS_ADD(mem_stats, memory_call_new, 1);
+        MEMORY_STATS_ADD(mem_stats, memory_request, mem_new->memory_request);
+        MEMORY_STATS_PRODUCE(mem_stats, mem_new->memory_produce);
+        MEMORY_STATS_ADD(mem_stats, memory_header, sizeof(mem_info_t));
+        MEMORY_STATS_ADD(mem_stats, memory_hist_sum, new_size_len);
+        MEMORY_STATS_ADD(mem_stats, memory_hist_request[memory_stats_bucket(new_size_len)], 1);
+        memory_stats_live(mem_stats, 0, new_size_len);
+        memory_stats_peak(mem_stats);
+    }
+#endif
+
+    return true;
+}
+#endif /*YAYA_MEMORY_ALIGN_USE*/
+
+bool memory_reserve(
+        #if YAYA_MEMORY_STATS_USE
+        mem_stats_t *mem_stats,
+        #endif
+        void **ptr,
+        const size_t count,
+        const size_t size)
+{
+#if YAYA_MEMORY_STATS_USE && YAYA_MEMORY_STATS_OFF
+    (void)(mem_stats);
+#endif
+    MEMORY_LATENCY_SCOPE(MEMORY_LATENCY_RES);
+
+    /*Проверка, что запрошено не нулевой размер памяти*/
+    const size_t capacity = (count * size);
+    if(capacity == 0){
+        return false;
+    }
+
+    /*Проверка, что указатели не NULL*/
+    if(ptr == NULL || *ptr == NULL){
+        return false;
+    }
+
+    mem_info_t *mem_old = memory_info(*ptr);
+    if(mem_old == NULL){
+        return false;
+    }
+    size_t old_size_r = mem_old->memory_request;
+    size_t old_size_p = memory_info_produce(mem_old);
+#if YAYA_MEMORY_SITE_USE || YAYA_MEMORY_SAMPLE_USE || YAYA_MEMORY_TAG_USE
+    size_t old_flags = memory_info_flags(mem_old);
+#endif
+
+    /*Емкости уже достаточно*/
+    if(capacity + MEMORY_INFO_SIZE <= old_size_p){
+        return true;
+    }
+
+#if YAYA_MEMORY_MMAP_USE
+    /*Блоки mmap растут без копирования, запас не нужен*/
+    if((memory_info_flags(mem_old) & MEMORY_KIND_MASK) == MEMORY_KIND_MMAP){
+        return true;
+    }
+#endif
+
+    size_t dirty = 0;
+    mem_info_t *mem_new = memory_block_res(mem_old, old_size_r, capacity, &dirty);
+    if(mem_new == NULL){
+        return false;
+    }
+
+    /*Запрошенный размер не меняется, весь запас заполняется хвостом*/
+    mem_new->memory_request = old_size_r;
+    memset(mem_new->memory_ptr + old_size_r, YAYA_MEMORY_VALUE_AFTER_MEM, memory_info_produce(mem_new) - MEMORY_INFO_SIZE - old_size_r);
+
+#if YAYA_MEMORY_TAG_USE
+    memory_tag_mark(mem_new, memory_tag_of(old_flags));
+#endif
+#if YAYA_MEMORY_SAMPLE_USE
+    memory_sample_move(mem_new, old_flags, *ptr);
+#endif
+#if YAYA_MEMORY_LIVE_USE
+    memory_live_move(*ptr, mem_new->memory_ptr);
+#endif
+
+    *ptr = mem_new->memory_ptr;
+
+#if YAYA_MEMORY_SITE_USE
+    /*Блок мог переехать в новый заголовок, место вызова сохраняется*/
+    memory_site_move(mem_new, old_flags, old_size_r, NULL);
+#endif
+
+#if YAYA_MEMORY_STATS_USE && !YAYA_MEMORY_STATS_OFF
+    /*Сохранение статистики*/
+    if(mem_stats != NULL){
+        MEMORY_STATS_ADD(mem_stats, memory_call_res, 1);
+        MEMORY_STATS_PRODUCE(mem_stats, memory_info_produce(mem_new) - old_size_p);
+        memory_stats_peak(mem_stats);
+    }
+#endif
+
+    return true;
+}
+
+bool memory_del(
+        #if YAYA_MEMORY_STATS_USE
+        mem_stats_t *mem_stats,
+        #endif
+        void **ptr)
+{
+#if YAYA_MEMORY_STATS_USE && YAYA_MEMORY_STATS_OFF
+    (void)(mem_stats);
+#endif
+    MEMORY_LATENCY_SCOPE(MEMORY_LATENCY_DEL);
+
+    /*Проверка, что указатели не NULL*/
+    if(ptr == NULL){
+        return false;
+    }
+
+    if(*ptr == NULL){
+        return false;
+    }
+
+    /*Указатели под структуру памяти*/
+    mem_info_t *mem = NULL;
+
+    /*Помещаем указатель со смещением*/
+    mem = memory_info(*ptr);
+    if(mem == NULL){
+        return false;
+    }
+
+    /*Источник блока до затирания заголовка*/
+    size_t flags = memory_info_flags(mem);
+    size_t produce = memory_info_produce(mem);
+    void *base = memory_info_base(mem);
+
+#if YAYA_MEMORY_ARENA_USE
+    /*Блоки арены освобождаются только сбросом арены*/
+    if((flags & MEMORY_KIND_MASK) == MEMORY_KIND_ARENA){
+        return false;
+    }
+#endif
+
+#if YAYA_MEMORY_CHECK_USE
+    memory_check_block(mem);
+#endif
+
+#if YAYA_MEMORY_SITE_USE
+    memory_site_drop(flags, mem->memory_request);
+#endif
+#if YAYA_MEMORY_TAG_USE
+    memory_tag_give(memory_tag_of(flags), mem->memory_request);
+#endif
+#if YAYA_MEMORY_SAMPLE_USE
+    memory_sample_drop(flags, *ptr);
+#endif
+#if YAYA_MEMORY_LIVE_USE
+    memory_live_erase(*ptr);
+#endif
+
+#if YAYA_MEMORY_STATS_USE && !YAYA_MEMORY_STATS_OFF
+    /*Сохранение статистики*/
+    if(mem_stats != NULL){
+        MEMORY_STATS_ADD(mem_stats, memory_call_del, 1);
+        MEMORY_STATS_RELEASE(mem_stats, produce);
+        MEMORY_STATS_ADD(mem_stats, memory_header, -sizeof(mem_info_t));
+#if YAYA_MEMORY_HUGE_USE
+        MEMORY_STATS_ADD(mem_stats, memory_huge, -memory_huge_size(flags, produce));
+#endif
+        memory_stats_live(mem_stats, mem->memory_request, 0);
+    }
+#endif
+
+#if !YAYA_MEMORY_QUARANTINE_USE
+    memory_block_wipe(base, flags, produce);
+#endif
+
+    memory_info_unbind(mem);
+#if YAYA_MEMORY_QUARANTINE_USE
+    memory_quarantine_push(base, flags, produce);
+#else
+    memory_block_del(base, flags, produce);
+#endif
+    mem = NULL;
+    *ptr = NULL;
+
+    return true;
+}
+
+bool memory_new_batch(
+        #if YAYA_MEMORY_STATS_USE
+        mem_stats_t *mem_stats,
+        #endif
+        void **ptrs,
+        const size_t count,
+        const size_t size)
+{
+#if YAYA_MEMORY_STATS_USE && YAYA_MEMORY_STATS_OFF
+    (void)(mem_stats);
+#endif
+    MEMORY_LATENCY_SCOPE(MEMORY_LATENCY_NEW);
+
+    /*Проверка, что запрошено не нулевой размер памяти и есть куда возвращать*/
+    if(ptrs == NULL || count == 0 || size == 0){
+        return false;
+    }
+
+    size_t done = 0;
+    size_t produce = 0;
+#if YAYA_MEMORY_HUGE_USE
+    size_t huge = 0;
+#endif
+
+#if YAYA_MEMORY_TAG_USE
+    /*Бюджет тега проверяется за всю пачку*/
+    size_t tag = memory_tag_current;
+    if(!memory_tag_take(tag, count * size)){
+        return false;
+    }
+#endif
+
+#if YAYA_MEMORY_SLAB_USE
+    /*Все блоки одного класса берутся за одну блокировку*/
+    size_t slab_class = memory_slab_find(size);
+    if(slab_class < MEMORY_SLAB_COUNT){
+        done = memory_slab_pop_batch(slab_class, ptrs, count);
+        produce = memory_slab_block(slab_class);
+        for(size_t i = 0; i < done; i++){
+            mem_info_t *mem = ptrs[i];
+
+            /*Зануление всего запрошеного и заполнение хвоста*/
+            memset(mem, 0x00, size + sizeof(mem_info_t));
+            memset(mem->memory_ptr + size, YAYA_MEMORY_VALUE_AFTER_MEM, produce - (size + sizeof(mem_info_t)));
+
+            mem->memory_request = size;
+            mem->memory_produce = produce;
+            mem->memory_flags   = MEMORY_KIND_SLAB | (slab_class << MEMORY_CLASS_SHIFT);
+
+            ptrs[i] = mem->memory_ptr;
+        }
+        produce *= done;
+    }else
+#endif
+    {
+        for(; done < count; done++){
+            mem_info_t *mem = memory_block_new(size);
+            if(mem == NULL){
+                break;
+            }
+            produce += memory_info_produce(mem);
+#if YAYA_MEMORY_HUGE_USE
+            huge += memory_huge_size(memory_info_flags(mem), mem->memory_produce);
+#endif
+            ptrs[done] = mem->memory_ptr;
+        }
+    }
+
+    /*Не все выделилось, возврат уже выделенного*/
+    if(done < count){
+        for(size_t i = 0; i < done; i++){
+            mem_info_t *mem = memory_info(ptrs[i]);
+            size_t produce_mem = memory_info_produce(mem);
+            void *base = memory_info_base(mem);
+            memory_info_unbind(mem);
+            memory_block_del(base, memory_info_flags(mem), produce_mem);
+        }
+        memset(ptrs, 0, sizeof(void*) * count);
+#if YAYA_MEMORY_TAG_USE
+        memory_tag_give(tag, count * size);
+#endif
+        return false;
+    }
+
+#if YAYA_MEMORY_TAG_USE
+    for(size_t i = 0; i < count; i++){
+        memory_tag_mark(memory_info(ptrs[i]), tag);
+    }
+#endif
+
+#if YAYA_MEMORY_SAMPLE_USE
+    /*Пачка считается одним выделением, в выборку попадает первый блок*/
+    memory_sample_tick(memory_info(ptrs[0]), count * size);
+#endif
+
+#if YAYA_MEMORY_LIVE_USE
+    uint64_t now = memory_live_now();
+    for(size_t i = 0; i < count; i++){
+        memory_live_insert(ptrs[i], now);
+    }
+#endif
+
+#if YAYA_MEMORY_STATS_USE && !YAYA_MEMORY_STATS_OFF
+    /*Сохранение статистики одним обновлением*/
+    if(mem_stats != NULL){
+        MEMORY_STATS_ADD(mem_stats, memory_call_new, count);
+        MEMORY_STATS_ADD(mem_stats, memory_request, count * size);
+        MEMORY_STATS_PRODUCE(mem_stats, produce);
+        MEMORY_STATS_ADD(mem_stats, memory_header, count * sizeof(mem_info_t));
+#if YAYA_MEMORY_HUGE_USE
+        MEMORY_STATS_ADD(mem_stats, memory_huge, huge);
+#endif
+        MEMORY_STATS_ADD(mem_stats, memory_hist_sum, count * size);
+        MEMORY_STATS_ADD(mem_stats, memory_hist_request[memory_stats_bucket(size)], count);
+        MEMORY_STATS_ADD(mem_stats, memory_hist_live[memory_stats_bucket(size)], count * size);
+        memory_stats_peak(mem_stats);
+    }
+#endif
+
+    return true;
+}
+
+bool memory_del_batch(
+        #if YAYA_MEMORY_STATS_USE
+        mem_stats_t *mem_stats,
+        #endif
+        void **ptrs,
+        const size_t count)
+{
+#if YAYA_MEMORY_STATS_USE && YAYA_MEMORY_STATS_OFF
+    (void)(mem_stats);
+#endif
+    MEMORY_LATENCY_SCOPE(MEMORY_LATENCY_DEL);
+
+    if(ptrs == NULL || count == 0){
+        return false;
+    }
+
+    bool all = true;
+    size_t done = 0;
+    size_t release = 0;
+#if YAYA_MEMORY_HUGE_USE
+    size_t huge = 0;
+#endif
+#if YAYA_MEMORY_STATS_USE && !YAYA_MEMORY_STATS_OFF
+    size_t live[YAYA_MEMORY_STATS_BUCKET] = {0};
+#endif
+
+#if YAYA_MEMORY_SLAB_USE
+    /*Цепочки освобожденных блоков по классам*/
+    mem_slab_free_t *head[MEMORY_SLAB_COUNT] = {0};
+    mem_slab_free_t *tail[MEMORY_SLAB_COUNT] = {0};
+#endif
+
+    for(size_t i = 0; i < count; i++){
+        if(ptrs[i] == NULL){
+            all = false;
+            continue;
+        }
+
+        mem_info_t *mem = memory_info(ptrs[i]);
+        if(mem == NULL){
+            all = false;
+            continue;
+        }
+        size_t flags = memory_info_flags(mem);
+        size_t produce = memory_info_produce(mem);
+        void *base = memory_info_base(mem);
+
+#if YAYA_MEMORY_ARENA_USE
+        /*Блоки арены освобождаются только сбросом арены*/
+        if((flags & MEMORY_KIND_MASK) == MEMORY_KIND_ARENA){
+            all = false;
+            continue;
+        }
+#endif
+
+#if YAYA_MEMORY_CHECK_USE
+        memory_check_block(mem);
+#endif
+
+#if YAYA_MEMORY_STATS_USE && !YAYA_MEMORY_STATS_OFF
+        live[memory_stats_bucket(mem->memory_request)] += mem->memory_request;
+#endif
+#if YAYA_MEMORY_SITE_USE
+        memory_site_drop(flags, mem->memory_request);
+#endif
+#if YAYA_MEMORY_TAG_USE
+        memory_tag_give(memory_tag_of(flags), mem->memory_request);
+#endif
+#if YAYA_MEMORY_SAMPLE_USE
+        memory_sample_drop(flags, ptrs[i]);
+#endif
+#if YAYA_MEMORY_LIVE_USE
+        memory_live_erase(ptrs[i]);
+#endif
+
+#if !YAYA_MEMORY_QUARANTINE_USE
+        memory_block_wipe(base, flags, produce);
+#endif
+        memory_info_unbind(mem);
+
+#if YAYA_MEMORY_QUARANTINE_USE
+        memory_quarantine_push(base, flags, produce);
+#else
+#if YAYA_MEMORY_SLAB_USE
+        if((flags & MEMORY_KIND_MASK) == MEMORY_KIND_SLAB){
+            size_t slab_class = (flags >> MEMORY_CLASS_SHIFT) & MEMORY_CLASS_MASK;
+            mem_slab_free_t *free_block = (mem_slab_free_t*)(mem);
+            free_block->next = head[slab_class];
+            head[slab_class] = free_block;
+            if(tail[slab_class] == NULL){
+                tail[slab_class] = free_block;
+            }
+        }else
+#endif
+        {
+            memory_block_del(base, flags, produce);
+        }
+#endif /*YAYA_MEMORY_QUARANTINE_USE*/
+
+        release += produce;
+#if YAYA_MEMORY_HUGE_USE
+        huge += memory_huge_size(flags, produce);
+#endif
+        done++;
+        ptrs[i] = NULL;
+    }
+
+#if YAYA_MEMORY_SLAB_USE
+    for(size_t c = 0; c < MEMORY_SLAB_COUNT; c++){
+        if(head[c] != NULL){
+            memory_slab_push_chain(c, head[c], tail[c]);
+        }
+    }
+#endif
+
+#if YAYA_MEMORY_STATS_USE && !YAYA_MEMORY_STATS_OFF
+    /*Сохранение статистики одним обновлением*/
+    if(mem_stats != NULL){
+        MEMORY_STATS_ADD(mem_stats, memory_call_del, done);
+        MEMORY_STATS_RELEASE(mem_stats, release);
+        MEMORY_STATS_ADD(mem_stats, memory_header, -(done * sizeof(mem_info_t)));
+#if YAYA_MEMORY_HUGE_USE
+        MEMORY_STATS_ADD(mem_stats, memory_huge, -huge);
+#endif
+        for(size_t b = 0; b < YAYA_MEMORY_STATS_BUCKET; b++){
+            if(live[b] != 0){
+                MEMORY_STATS_ADD(mem_stats, memory_hist_live[b], -live[b]);
+            }
+        }
+    }
+#else
+    (void)(release);
+#if YAYA_MEMORY_HUGE_USE
+    (void)(huge);
+#endif
+#endif
+
+    return all;
+}
+
+#if YAYA_MEMORY_ARENA_USE
+/*Кусок памяти арены, блоки нарезаются последовательно*/
+typedef struct mem_arena_chunk_t {
+    struct mem_arena_chunk_t *next;
+    size_t size;
+    alignas(max_align_t) uint8_t data[];
+}mem_arena_chunk_t;
+
+struct mem_arena_t {
+    mem_arena_chunk_t *head;   //первый кусок
+    mem_arena_chunk_t *chunk;  //текущий кусок
+    size_t offset;             //занято в текущем куске
+    size_t chunk_size;         //размер нового куска
+    size_t produce;            //выдано с последнего сброса
+    size_t count;              //блоков с последнего сброса, перенесенные копии не считаются
+    mem_info_t *last;          //последний блок, может расти на месте
+#if YAYA_MEMORY_STATS_USE && !YAYA_MEMORY_STATS_OFF
+    size_t live[YAYA_MEMORY_STATS_BUCKET]; //запрошено по корзинам с последнего сброса
+#endif
+};
+
+/*Размер блока арены вместе с заголовком, кратно max_align_t*/
+static inline size_t memory_arena_block(size_t request)
+{
+    size_t block = sizeof(mem_info_t) + request;
+    return (block + alignof(max_align_t) - 1) & ~(alignof(max_align_t) - 1);
+}
+
+/*Переход к куску, в котором поместится блок*/
+static bool memory_arena_grow(mem_arena_t *arena, size_t block)
+{
+    /*Использование куска, оставшегося после сброса*/
+    mem_arena_chunk_t *next = (arena->chunk != NULL) ? arena->chunk->next : arena->head;
+    if(next != NULL && next->size >= block){
+        arena->chunk  = next;
+        arena->offset = 0;
+        return true;
+    }
+
+    size_t size = (block > arena->chunk_size) ? block : arena->chunk_size;
+    mem_arena_chunk_t *chunk = malloc(sizeof(mem_arena_chunk_t) + size);
+    if(chunk == NULL){
+        return false;
+    }
+    chunk->size = size;
+    chunk->next = next;
+
+    /*Вставка нового куска за текущим*/
+    if(arena->chunk != NULL){
+        arena->chunk->next = chunk;
+    }else{
+        arena->head = chunk;
+    }
+    arena->chunk  = chunk;
+    arena->offset = 0;
+    return true;
+}
+
+bool memory_arena_init(mem_arena_t **arena, size_t chunk)
+{
+    if(arena == NULL){
+        return false;
+    }
+
+    if(*arena == NULL){
+        *arena = (mem_arena_t*)malloc(sizeof(mem_arena_t));
+        if(*arena == NULL){
+            return false;
+        }
+
+        memset(*arena, 0, sizeof(mem_arena_t));
+        (*arena)->chunk_size = (chunk != 0) ? chunk : YAYA_MEMORY_ARENA_CHUNK;
+        return true;
+    }
+
+    return false;
+}
+
+bool memory_arena_reset(
+        #if YAYA_MEMORY_STATS_USE
+        mem_stats_t *mem_stats,
+        #endif
+        mem_arena_t *arena)
+{
+#if YAYA_MEMORY_STATS_USE && YAYA_MEMORY_STATS_OFF
+    (void)(mem_stats);
+#endif
+
+    if(arena == NULL){
+        return false;
+    }
+
+#if YAYA_MEMORY_STATS_USE && !YAYA_MEMORY_STATS_OFF
+    /*Сохранение статистики, все блоки освобождаются разом*/
+    if(mem_stats != NULL){
+        MEMORY_STATS_ADD(mem_stats, memory_call_del, arena->count);
+        MEMORY_STATS_RELEASE(mem_stats, arena->produce);
+        MEMORY_STATS_ADD(mem_stats, memory_header, -(arena->count * sizeof(mem_info_t)));
+        for(size_t b = 0; b < YAYA_MEMORY_STATS_BUCKET; b++){
+            if(arena->live[b] != 0){
+                MEMORY_STATS_ADD(mem_stats, memory_hist_live[b], -arena->live[b]);
+            }
+        }
+    }
+    memset(arena->live, 0, sizeof(arena->live));
+#endif
+
+    /*Куски остаются за ареной и переиспользуются*/
+    arena->chunk   = NULL;
+    arena->offset  = 0;
+    arena->produce = 0;
+    arena->count   = 0;
+    arena->last    = NULL;
+
+    return true;
+}
+
+bool memory_arena_free(
+        #if YAYA_MEMORY_STATS_USE
+        mem_stats_t *mem_stats,
+        #endif
+        mem_arena_t **arena)
+{
+    if(arena == NULL || *arena == NULL){
+        return false;
+    }
+
+#if YAYA_MEMORY_STATS_USE
+    memory_arena_reset(mem_stats, *arena);
+#else
+    memory_arena_reset(*arena);
+#endif
+
+    mem_arena_chunk_t *chunk = (*arena)->head;
+    while(chunk != NULL){
+        mem_arena_chunk_t *next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+
+    free(*arena);
+    *arena = NULL;
+    return true;
+}
+
+bool memory_arena_new(
+        #if YAYA_MEMORY_STATS_USE
+        mem_stats_t *mem_stats,
+        #endif
+        mem_arena_t *arena,
+        void **ptr,
+        void *old_ptr,
+        const size_t count,
+        const size_t size)
+{
+#if YAYA_MEMORY_STATS_USE && YAYA_MEMORY_STATS_OFF
+    (void)(mem_stats);
+#endif
+
+    /*Проверка, что запрошено не нулевой размер памяти*/
+    const size_t new_size_len = (count * size);
+    if(new_size_len == 0){
+        return false;
+    }
+
+    /*Проверка, что возвращать есть куда*/
+    if(ptr == NULL || arena == NULL){
+        return false;
+    }
+
+    mem_info_t *mem_old = NULL;
+    size_t old_size_r = 0;
+    size_t block = memory_arena_block(new_size_len);
+
+    if(old_ptr != NULL){
+        mem_old = memory_info(old_ptr);
+        if((memory_info_flags(mem_old) & MEMORY_KIND_MASK) != MEMORY_KIND_ARENA){
+            return false;
+        }
+        old_size_r = mem_old->memory_request;
+
+        /*Последний блок растет или сжимается на месте*/
+        if(mem_old == arena->last && (arena->offset - mem_old->memory_produce) + block <= arena->chunk->size){
+            size_t old_size_p = mem_old->memory_produce;
+            size_t used = (new_size_len > old_size_r) ? old_size_r : new_size_len;
+
+            memset(mem_old->memory_ptr + used, 0x00, new_size_len - used);
+            memset(mem_old->memory_ptr + new_size_len, YAYA_MEMORY_VALUE_AFTER_MEM, block - sizeof(mem_info_t) - new_size_len);
+
+            mem_old->memory_request = new_size_len;
+            mem_old->memory_produce = block;
+            arena->offset  = arena->offset - old_size_p + block;
+            arena->produce = arena->produce - old_size_p + block;
+
+            *ptr = mem_old->memory_ptr;
+
+#if YAYA_MEMORY_STATS_USE && !YAYA_MEMORY_STATS_OFF
+            /*Сохранение статистики*/
+            if(mem_stats != NULL){
+                MEMORY_STATS_ADD(mem_stats, memory_call_res, 1);
+                MEMORY_STATS_ADD(mem_stats, memory_request, new_size_len - old_size_r);
+                MEMORY_STATS_PRODUCE(mem_stats, block - old_size_p);
+                MEMORY_STATS_ADD(mem_stats, memory_hist_sum, new_size_len);
+                MEMORY_STATS_ADD(mem_stats, memory_hist_request[memory_stats_bucket(new_size_len)], 1);
+                memory_stats_live(mem_stats, old_size_r, new_size_len);
+                memory_stats_peak(mem_stats);
+            }
+            arena->live[memory_stats_bucket(old_size_r)]   -= old_size_r;
+            arena->live[memory_stats_bucket(new_size_len)] += new_size_len;
+#endif
+            return true;
+        }
+    }
+
+    /*Выделение нового блока из текущего или следующего куска*/
+    if(arena->chunk == NULL || arena->offset + block > arena->chunk->size){
+        if(!memory_arena_grow(arena, block)){
+            return false;
+        }
+    }
+
+    mem_info_t *mem_new = (mem_info_t*)(arena->chunk->data + arena->offset);
+    arena->offset  += block;
+    arena->produce += block;
+    arena->last     = mem_new;
+
+    /*Перенесенный блок заменяет старый: заголовок и вызов уже учтены*/
+    if(mem_old == NULL){
+        arena->count += 1;
+    }
+
+    /*Зануление всего запрошеного и заполнение хвоста*/
+    memset(mem_new, 0x00, sizeof(mem_info_t) + new_size_len);
+    memset(mem_new->memory_ptr + new_size_len, YAYA_MEMORY_VALUE_AFTER_MEM, block - sizeof(mem_info_t) - new_size_len);
+
+    mem_new->memory_request = new_size_len;
+    mem_new->memory_produce = block;
+    mem_new->memory_flags   = MEMORY_KIND_ARENA;
+
+    /*Перенос данных, старый блок остается в арене до сброса*/
+    if(mem_old != NULL){
+        memcpy(mem_new->memory_ptr, mem_old->memory_ptr, (old_size_r < new_size_len) ? old_size_r : new_size_len);
+    }
+
+    *ptr = mem_new->memory_ptr;
+
+#if YAYA_MEMORY_STATS_USE && !YAYA_MEMORY_STATS_OFF
+    /*Сохранение статистики*/
+    if(mem_stats != NULL){
+        if(mem_old == NULL){
+            MEMORY_STATS_ADD(mem_stats, memory_call_new, 1);
+            MEMORY_STATS_ADD(mem_stats, memory_request, new_size_len);
+            MEMORY_STATS_ADD(mem_stats, memory_header, sizeof(mem_info_t));
+        }else{
+            MEMORY_STATS_ADD(mem_stats, memory_call_res, 1);
+            MEMORY_STATS_ADD(mem_stats, memory_request, new_size_len - old_size_r);
+        }
+        MEMORY_STATS_PRODUCE(mem_stats, block);
+        MEMORY_STATS_ADD(mem_stats, memory_hist_sum, new_size_len);
+        MEMORY_STATS_ADD(mem_stats, memory_hist_request[memory_stats_bucket(new_size_len)], 1);
+        memory_stats_live(mem_stats, old_size_r, new_size_len);
+        memory_stats_peak(mem_stats);
+    }
+    if(old_size_r != 0){
+        arena->live[memory_stats_bucket(old_size_r)] -= old_size_r;
+    }
+    arena->live[memory_stats_bucket(new_size_len)] += new_size_len;
+#endif
+
+    return true;
+}
+#endif /*YAYA_MEMORY_ARENA_USE*/
+
+#if YAYA_MEMORY_SITE_USE
+bool memory_new_site(
+        #if YAYA_MEMORY_STATS_USE
+        mem_stats_t *mem_stats,
+        #endif
+        mem_site_t *site,
+        void **ptr,
+        void *old_ptr,
+        const size_t count,
+        const size_t size)
+{
+    /*Место вызова передается в memory_new через поток*/
+    memory_site_current = site;
+#if YAYA_MEMORY_STATS_USE
+    bool res = memory_new(mem_stats, ptr, old_ptr, count, size);
+#else
+    bool res = memory_new(ptr, old_ptr, count, size);
+#endif
+    memory_site_current = NULL;
+    return res;
+}
+
+static int memory_site_compare(const void *a, const void *b)
+{
+    size_t live_a = ((const mem_site_t*)(a))->memory_live;
+    size_t live_b = ((const mem_site_t*)(b))->memory_live;
+    return (live_a < live_b) - (live_a > live_b);
+}
+
+size_t memory_site_top(mem_site_t *sites, size_t count)
+{
+    if(sites == NULL || count == 0){
+        return 0;
+    }
+
+    size_t total = __atomic_load_n(&memory_site_count, __ATOMIC_ACQUIRE);
+    total = (total < YAYA_MEMORY_SITE_COUNT) ? total : YAYA_MEMORY_SITE_COUNT;
+
+    mem_site_t *copy = malloc(sizeof(mem_site_t) * (total + 1));
+    if(copy == NULL){
+        return 0;
+    }
+
+    /*Копии счетчиков, чтобы порядок не менялся во время сортировки*/
+    size_t found = 0;
+    for(size_t i = 0; i < total; i++){
+        mem_site_t *site = __atomic_load_n(&memory_site_table[i], __ATOMIC_ACQUIRE);
+        if(site != NULL){
+            copy[found] = *site;
+            copy[found].memory_call    = __atomic_load_n(&site->memory_call,    __ATOMIC_RELAXED);
+            copy[found].memory_request = __atomic_load_n(&site->memory_request, __ATOMIC_RELAXED);
+            copy[found].memory_live    = __atomic_load_n(&site->memory_live,    __ATOMIC_RELAXED);
+            found++;
+        }
+    }
+
+    /*Сортировка по убыванию живых байт*/
+    if(found > 1){
+        memory_sort(copy, found, sizeof(mem_site_t), memory_site_compare);
+    }
+
+    found = (found < count) ? found : count;
+    memcpy(sites, copy, sizeof(mem_site_t) * found);
+    free(copy);
+
+    return found;
+}
+
+bool memory_site_show(size_t count)
+{
+    if(count == 0){
+        return false;
+    }
+
+    mem_site_t *sites = malloc(sizeof(mem_site_t) * count);
+    if(sites == NULL){
+        return false;
+    }
+
+    size_t found = memory_site_top(sites, count);
+    for(size_t i = 0; i < found; i++){
+        printf("LIVE:%10zu; ",  sites[i].memory_live);
+        printf("NEW:%10zu; ",   sites[i].memory_call);
+        printf("Request:%10zu; ", sites[i].memory_request);
+        printf("%s:%zu %s", sites[i].memory_file, sites[i].memory_line, sites[i].memory_func);
+        printf("\n");
+    }
+    free(sites);
+
+    if(fflush(stdout) == 0){
+        return true;
+    }
+    return false;
+}
+#endif /*YAYA_MEMORY_SITE_USE*/
+
+#if YAYA_MEMORY_SAMPLE_USE
+bool memory_sample_rate(size_t rate)
+{
+    atomic_store_explicit(&memory_sample_mean, rate, memory_order_relaxed);
+
+    /*В вызывающем потоке новый шаг действует сразу*/
+    memory_sample_left = memory_sample_next(rate);
+    return true;
+}
+
+size_t memory_sample_count(void)
+{
+    return atomic_load_explicit(&memory_sample_live, memory_order_relaxed);
+}
+
+bool memory_sample_dump(FILE *file)
+{
+    if(file == NULL){
+        return false;
+    }
+
+    /*Копия таблицы, чтобы не держать блокировку во время вывода*/
+    mem_sample_t *copy = malloc(sizeof(mem_sample_t) * YAYA_MEMORY_SAMPLE_COUNT);
+    if(copy == NULL){
+        return false;
+    }
+
+    size_t found = 0;
+    size_t bytes = 0;
+    memory_sample_lock();
+    for(size_t i = 0; i < YAYA_MEMORY_SAMPLE_COUNT; i++){
+        if(memory_sample_table[i].memory_ptr != NULL){
+            copy[found] = memory_sample_table[i];
+            bytes += copy[found].memory_request;
+            found++;
+        }
+    }
+    memory_sample_unlock();
+
+    /*Формат heap_v2: счетчики выборки, pprof сам восстанавливает полные значения по шагу*/
+    size_t mean = atomic_load_explicit(&memory_sample_mean, memory_order_relaxed);
+    fprintf(file, "heap profile: %zu: %zu [%zu: %zu] @ heap_v2/%zu\n", found, bytes, found, bytes, mean);
+    for(size_t i = 0; i < found; i++){
+        fprintf(file, "1: %zu [1: %zu] @", copy[i].memory_request, copy[i].memory_request);
+        for(size_t d = 0; d < copy[i].memory_depth; d++){
+            fprintf(file, " %p", copy[i].memory_stack[d]);
+        }
+        fprintf(file, "\n");
+    }
+    free(copy);
+
+    /*Карта памяти процесса для поиска символов*/
+    fprintf(file, "\nMAPPED_LIBRARIES:\n");
+    FILE *maps = fopen("/proc/self/maps", "r");
+    if(maps != NULL){
+        char buf[4096];
+        size_t len = 0;
+        while((len = fread(buf, 1, sizeof(buf), maps)) > 0){
+            fwrite(buf, 1, len, file);
+        }
+        fclose(maps);
+    }
+
+    if(fflush(file) == 0){
+        return true;
+    }
+    return false;
+}
+#endif /*YAYA_MEMORY_SAMPLE_USE*/
+
+#if YAYA_MEMORY_LATENCY_USE
+/*Наносекунд в одном такте часов замера*/
+static double memory_latency_scale(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    uint64_t nano_beg = __atomic_load_n(&memory_latency_nano_beg, __ATOMIC_ACQUIRE);
+    uint64_t tick_beg = __atomic_load_n(&memory_latency_tick_beg, __ATOMIC_RELAXED);
+    if(nano_beg == 0){
+        return 1.0;
+    }
+
+    /*Для точности между отсчетами не меньше 10 мс*/
+    uint64_t nano = memory_latency_nano();
+    if(nano - nano_beg < 10000000U){
+        struct timespec pause = {0, (long)(10000000U - (nano - nano_beg))};
+        nanosleep(&pause, NULL);
+    }
+    uint64_t tick = memory_latency_tick();
+    nano = memory_latency_nano();
+    return (double)(nano - nano_beg) / (double)(tick - tick_beg);
+#else
+    return 1.0;
+#endif
+}
+
+bool memory_latency_get(mem_latency_kind_t kind, mem_latency_t *latency)
+{
+    if(latency == NULL || (size_t)(kind) >= MEMORY_LATENCY_KIND){
+        return false;
+    }
+
+    size_t *count = calloc(MEMORY_LATENCY_BUCKET, sizeof(size_t));
+    if(count == NULL){
+        return false;
+    }
+
+    /*Сведение гистограмм всех потоков*/
+    size_t total = 0;
+    for(mem_latency_hist_t *hist = __atomic_load_n(&memory_latency_list, __ATOMIC_ACQUIRE); hist != NULL; hist = hist->memory_next){
+        for(size_t i = 0; i < MEMORY_LATENCY_BUCKET; i++){
+            size_t c = __atomic_load_n(&hist->memory_count[kind][i], __ATOMIC_RELAXED);
+            count[i] += c;
+            total += c;
+        }
+    }
+
+    memset(latency, 0, sizeof(mem_latency_t));
+    latency->memory_count = total;
+    if(total == 0){
+        free(count);
+        return true;
+    }
+
+    /*Ранги перцентилей с округлением вверх*/
+    double scale = memory_latency_scale();
+    size_t rank[3] = {(total * 500 + 999) / 1000, (total * 990 + 999) / 1000, (total * 999 + 999) / 1000};
+    uint64_t *value[3] = {&latency->memory_p50, &latency->memory_p99, &latency->memory_p999};
+
+    size_t seen = 0;
+    size_t next = 0;
+    for(size_t i = 0; i < MEMORY_LATENCY_BUCKET; i++){
+        if(count[i] == 0){
+            continue;
+        }
+        seen += count[i];
+        uint64_t nano = (uint64_t)((double)(memory_latency_value(i)) * scale);
+        while(next < 3 && seen >= rank[next]){
+            *value[next] = nano;
+            next++;
+        }
+        latency->memory_max = nano;
+    }
+    free(count);
+
+    return true;
+}
+
+bool memory_latency_show(void)
+{
+    static const char *name[MEMORY_LATENCY_KIND] = {"NEW", "RES", "DEL", "SORT", "SEARCH", "SHUF"};
+
+    for(size_t k = 0; k < MEMORY_LATENCY_KIND; k++){
+        mem_latency_t latency = {0};
+        if(!memory_latency_get((mem_latency_kind_t)(k), &latency)){
+            return false;
+        }
+        printf("%-6s: ",          name[k]);
+        printf("Count:%10zu; ",   latency.memory_count);
+        printf("p50:%10" PRIu64 " ns; ",  latency.memory_p50);
+        printf("p99:%10" PRIu64 " ns; ",  latency.memory_p99);
+        printf("p999:%10" PRIu64 " ns; ", latency.memory_p999);
+        printf("Max:%10" PRIu64 " ns",    latency.memory_max);
+        printf("\n");
+    }
+
+    if(fflush(stdout) == 0){
+        return true;
+    }
+    return false;
+}
+
+bool memory_latency_reset(void)
+{
+    /*Замеры других потоков во время сброса могут сохраниться*/
+    for(mem_latency_hist_t *hist = __atomic_load_n(&memory_latency_list, __ATOMIC_ACQUIRE); hist != NULL; hist = hist->memory_next){
+        for(size_t k = 0; k < MEMORY_LATENCY_KIND; k++){
+            for(size_t i = 0; i < MEMORY_LATENCY_BUCKET; i++){
+                __atomic_store_n(&hist->memory_count[k][i], 0, __ATOMIC_RELAXED);
+            }
+        }
+    }
+    return true;
+}
+#endif /*YAYA_MEMORY_LATENCY_USE*/
+
+#if YAYA_MEMORY_LIVE_USE
+size_t memory_live_count(void)
+{
+    return atomic_load_explicit(&memory_live_used, memory_order_relaxed);
+}
+
+size_t memory_live_dropped(void)
+{
+    return atomic_load_explicit(&memory_live_lost, memory_order_relaxed);
+}
+
+bool memory_live_show(size_t head)
+{
+    uint64_t now = memory_live_now();
+    size_t lost = memory_live_dropped();
+    if(lost != 0){
+        printf("LIVE LOST: %zu blocks not tracked, YAYA_MEMORY_LIVE_COUNT is full\n", lost);
+    }
+    for(size_t i = 0; i < YAYA_MEMORY_LIVE_COUNT; i++){
+        void *ptr = __atomic_load_n(&memory_live_table[i].memory_ptr, __ATOMIC_ACQUIRE);
+        if(ptr == NULL || ptr == MEMORY_LIVE_TOMB){
+            continue;
+        }
+        mem_info_t *mem = memory_info(ptr);
+        if(mem == NULL){
+            continue;
+        }
+        uint64_t time = __atomic_load_n(&memory_live_table[i].memory_time, __ATOMIC_RELAXED);
+
+        printf("LIVE: %p; ", ptr);
+        printf("Request:%10zu; ", mem->memory_request);
+        printf("Age:%10" PRIu64 " ms; ", (now > time) ? now - time : 0);
+#if YAYA_MEMORY_SITE_USE
+        mem_site_t *site = memory_site_of(memory_info_flags(mem));
+        if(site != NULL){
+            printf("%s:%zu %s", site->memory_file, site->memory_line, site->memory_func);
+        }
+#endif
+        printf("\n");
+
+        /*Начало блока*/
+        if(head != 0){
+            memory_dump(ptr, (mem->memory_request < head) ? mem->memory_request : head, 1, 16);
+        }
+    }
+
+    if(fflush(stdout) == 0){
+        return true;
+    }
+    return false;
+}
+
+static void memory_live_exit(void)
+{
+    size_t count = memory_live_count();
+    if(count != 0 || memory_live_dropped() != 0){
+        printf("LEAK: %zu blocks\n", count);
+        memory_live_show(memory_live_head);
+    }
+}
+
+bool memory_live_atexit(size_t head)
+{
+    static atomic_flag once = ATOMIC_FLAG_INIT;
+
+    memory_live_head = head;
+    if(atomic_flag_test_and_set_explicit(&once, memory_order_relaxed)){
+        return true;
+    }
+    return atexit(memory_live_exit) == 0;
+}
+#endif /*YAYA_MEMORY_LIVE_USE*/
+
+#if YAYA_MEMORY_CHECK_USE
+bool memory_check(void *ptr)
+{
+    /*Проверка, что указатель не NULL*/
+    if(ptr == NULL){
+        return false;
+    }
+
+    mem_info_t *mem = memory_info(ptr);
+    if(mem == NULL){
+        return false;
+    }
+    return memory_check_block(mem);
+}
+
+#if YAYA_MEMORY_LIVE_USE
+size_t memory_check_all(void)
+{
+    size_t fail = 0;
+    for(size_t i = 0; i < YAYA_MEMORY_LIVE_COUNT; i++){
+        void *ptr = __atomic_load_n(&memory_live_table[i].memory_ptr, __ATOMIC_ACQUIRE);
+        if(ptr == NULL || ptr == MEMORY_LIVE_TOMB){
+            continue;
+        }
+        mem_info_t *mem = memory_info(ptr);
+        if(mem != NULL && !memory_check_block(mem)){
+            fail++;
+        }
+    }
+    return fail;
+}
+#endif /*YAYA_MEMORY_LIVE_USE*/
+#endif /*YAYA_MEMORY_CHECK_USE*/
+
+#if YAYA_MEMORY_QUARANTINE_USE
+bool memory_quarantine_flush(void)
+{
+    if(memory_quarantine_local == NULL){
+        return true;
+    }
+    return memory_quarantine_drain(memory_quarantine_local);
+}
+#endif /*YAYA_MEMORY_QUARANTINE_USE*/
+
+#if YAYA_MEMORY_TAG_USE
+size_t memory_tag_set(size_t tag)
+{
+    if(tag >= YAYA_MEMORY_TAG_COUNT){
+        return SIZE_MAX;
+    }
+    size_t old = memory_tag_current;
+    memory_tag_current = tag;
+    return old;
+}
+
+bool memory_tag_budget(size_t tag, size_t soft, size_t hard, mem_tag_fn_t callback)
+{
+    if(tag >= YAYA_MEMORY_TAG_COUNT){
+        return false;
+    }
+
+    mem_tag_t *info = &memory_tag_table[tag];
+    __atomic_store_n(&info->memory_callback, callback, __ATOMIC_RELEASE);
+    __atomic_store_n(&info->memory_soft, soft, __ATOMIC_RELAXED);
+    __atomic_store_n(&info->memory_hard, hard, __ATOMIC_RELAXED);
+    return true;
+}
+
+bool memory_tag_get(size_t tag, mem_tag_t *info)
+{
+    if(tag >= YAYA_MEMORY_TAG_COUNT || info == NULL){
+        return false;
     }
-#endif
-
-    free(mem);
-    mem = NULL;
-    *ptr = NULL;
 
+    mem_tag_t *src = &memory_tag_table[tag];
+    info->memory_live     = __atomic_load_n(&src->memory_live,     __ATOMIC_RELAXED);
+    info->memory_call     = __atomic_load_n(&src->memory_call,     __ATOMIC_RELAXED);
+    info->memory_fail     = __atomic_load_n(&src->memory_fail,     __ATOMIC_RELAXED);
+    info->memory_soft     = __atomic_load_n(&src->memory_soft,     __ATOMIC_RELAXED);
+    info->memory_hard     = __atomic_load_n(&src->memory_hard,     __ATOMIC_RELAXED);
+    info->memory_callback = __atomic_load_n(&src->memory_callback, __ATOMIC_ACQUIRE);
     return true;
 }
 
+bool memory_tag_show(void)
+{
+    for(size_t i = 0; i < YAYA_MEMORY_TAG_COUNT; i++){
+        mem_tag_t info = {0};
+        memory_tag_get(i, &info);
+        if(info.memory_call == 0 && info.memory_fail == 0){
+            continue;
+        }
+        printf("TAG:%5zu; ",      i);
+        printf("LIVE:%10zu; ",    info.memory_live);
+        printf("NEW:%10zu; ",     info.memory_call);
+        printf("FAIL:%10zu; ",    info.memory_fail);
+        printf("Soft:%10zu; ",    info.memory_soft);
+        printf("Hard:%10zu",      info.memory_hard);
+        printf("\n");
+    }
+
+    if(fflush(stdout) == 0){
+        return true;
+    }
+    return false;
+}
+#endif /*YAYA_MEMORY_TAG_USE*/
+
 bool memory_zero(void *ptr)
 {
     /*Проверка, что указатели не NULL*/
@@ -247,16 +3644,13 @@ bool memory_zero(void *ptr)
     mem_info_t *mem_info = NULL;
 
     /*Помещаем указатель со смещением*/
-    mem_info = ptr - offsetof(mem_info_t, memory_ptr);
-
-    /*Сохраняем значения*/
-    volatile size_t  size = mem_info->memory_request;
-    volatile uint8_t *p   = mem_info->memory_ptr;
+    mem_info = memory_info(ptr);
+    if(mem_info == NULL){
+        return false;
+    }
 
     /*Заполняем нулями*/
-    while (size--){
-        *p++ = 0;
-    }
+    memory_wipe(mem_info->memory_ptr, 0x00, mem_info->memory_request);
 
     return true;
 }
@@ -272,7 +3666,10 @@ size_t memory_size(void *ptr)
     mem_info_t *mem_info = NULL;
 
     /*Помещаем указатель со смещением*/
-    mem_info = ptr - offsetof(mem_info_t, memory_ptr);
+    mem_info = memory_info(ptr);
+    if(mem_info == NULL){
+        return 0;
+    }
 
     /*Возвращаем размер запрошеной памяти*/
     return mem_info->memory_request;
@@ -321,12 +3718,282 @@ intmax_t memory_step(void* ptr_beg, void* ptr_bend, size_t size)
     return (intmax_t)(dist / (ptrdiff_t)(size));
 }
 
+/*Генератор перемешивания: wyrand на состоянии вызова или свой генератор как rand*/
+typedef struct mem_rand_t {
+    uint64_t      state;
+    mem_rand_fn_t get_rand;
+}mem_rand_t;
+
+static inline uint64_t memory_rand_next(mem_rand_t *rng)
+{
+    if(rng->get_rand != NULL){
+        /*Значения от 0 до RAND_MAX складываются в 64 бита, старшие биты нужны memory_rand_bound*/
+        const int bits = 63 - __builtin_clzll((unsigned long long)(RAND_MAX) + 1);
+        uint64_t word = 0;
+        for(int have = 0; have < 64; have += bits){
+            word = (word << bits) ^ (uint64_t)(rng->get_rand());
+        }
+        return word;
+    }
+
+    rng->state += 0xa0761d6478bd642fULL;
+    __uint128_t m = (__uint128_t)(rng->state) * (rng->state ^ 0xe7037ed1a0b428dbULL);
+    return (uint64_t)(m >> 64) ^ (uint64_t)(m);
+}
+
+/*Равномерно из [0, bound) умножением с отбрасыванием по Лемиру, деление только в редком случае*/
+static inline size_t memory_rand_bound(mem_rand_t *rng, size_t bound)
+{
+    __uint128_t m = (__uint128_t)(memory_rand_next(rng)) * (uint64_t)(bound);
+    uint64_t low = (uint64_t)(m);
+    if(low < bound){
+        uint64_t threshold = (uint64_t)(-(uint64_t)(bound)) % bound;
+        while(low < threshold){
+            m = (__uint128_t)(memory_rand_next(rng)) * (uint64_t)(bound);
+            low = (uint64_t)(m);
+        }
+    }
+    return (size_t)(m >> 64);
+}
+
+/*Тасование Фишера-Йетса, размер элемента константа после встраивания*/
+static inline __attribute__((always_inline)) void memory_shuf_pass(uint8_t *base, size_t count, size_t size, mem_rand_t *rng)
+{
+    uint8_t temp[size];
+    for(size_t i = count - 1; i > 0; i--){
+        size_t j = memory_rand_bound(rng, i + 1);
+        memcpy(temp,            base + i * size, size);
+        memcpy(base + i * size, base + j * size, size);
+        memcpy(base + j * size, temp,            size);
+    }
+}
+
 bool memory_shuf(void *base, size_t count, size_t size, unsigned int seed, void (*set_seed)(unsigned int), int (*get_rand)(void))
 {
+    MEMORY_LATENCY_SCOPE(MEMORY_LATENCY_SHUF);
+
+    /*Проверка, что указатели не NULL*/
+    if(base == NULL){
+        return false;
+    }
+    if(count == 0){
+        return false;
+    }
+    if(size == 0){
+        return false;
+    }
+
+    /*Без своего генератора состояние у каждого вызова свое, порядок зависит только от seed.
+      Свой генератор без set_seed засевается srand, как раньше*/
+    mem_rand_t rng = {.state = seed, .get_rand = get_rand};
+    if(get_rand != NULL){
+        if(set_seed == NULL){
+            set_seed = (mem_seed_fn_t)(srand);
+        }
+        set_seed(seed);
+    }
+
+    switch(size){
+        case 1:  memory_shuf_pass(base, count, 1,    &rng); break;
+        case 2:  memory_shuf_pass(base, count, 2,    &rng); break;
+        case 4:  memory_shuf_pass(base, count, 4,    &rng); break;
+        case 8:  memory_shuf_pass(base, count, 8,    &rng); break;
+        case 16: memory_shuf_pass(base, count, 16,   &rng); break;
+        default: memory_shuf_pass(base, count, size, &rng); break;
+    }
+    return true;
+}
+
+/*Шаблон интроспективной сортировки для элементов типа TYPE и сравнения LESS(a, b).
+  Малые части вставками, опорный медианой трех или девяти, разбиение Ломуто без ветвлений,
+  пирамидальная сортировка при исчерпании глубины. Равные опорному отделяются за один проход,
+  как в pdqsort. LESS получает lvalue и может использовать compare*/
+#define MEMORY_SORT_SMALL 16
+
+#define MEMORY_SORT_KERNEL(NAME, TYPE, LESS)                                                   \
+static void NAME##_insert(TYPE *a, size_t n, mem_compare_fn_t compare)                        \
+{                                                                                              \
+    (void)(compare);                                                                           \
+    for(size_t i = 1; i < n; i++){                                                             \
+        TYPE v = a[i];                                                                         \
+        size_t j = i;                                                                          \
+        while(j > 0 && LESS(v, a[j - 1])){                                                     \
+            a[j] = a[j - 1];                                                                   \
+            j--;                                                                               \
+        }                                                                                      \
+        a[j] = v;                                                                              \
+    }                                                                                          \
+}                                                                                              \
+                                                                                               \
+static void NAME##_sift(TYPE *a, size_t i, size_t n, mem_compare_fn_t compare)                \
+{                                                                                              \
+    (void)(compare);                                                                           \
+    TYPE v = a[i];                                                                             \
+    for(size_t c = 2 * i + 1; c < n; c = 2 * i + 1){                                           \
+        if(c + 1 < n && LESS(a[c], a[c + 1])){                                                 \
+            c++;                                                                               \
+        }                                                                                      \
+        if(!LESS(v, a[c])){                                                                    \
+            break;                                                                             \
+        }                                                                                      \
+        a[i] = a[c];                                                                           \
+        i = c;                                                                                 \
+    }                                                                                          \
+    a[i] = v;                                                                                  \
+}                                                                                              \
+                                                                                               \
+static void NAME##_heap(TYPE *a, size_t n, mem_compare_fn_t compare)                          \
+{                                                                                              \
+    for(size_t i = n / 2; i-- > 0;){                                                           \
+        NAME##_sift(a, i, n, compare);                                                         \
+    }                                                                                          \
+    for(size_t i = n - 1; i > 0; i--){                                                         \
+        TYPE t = a[0];                                                                         \
+        a[0] = a[i];                                                                           \
+        a[i] = t;                                                                              \
+        NAME##_sift(a, 0, i, compare);                                                         \
+    }                                                                                          \
+}                                                                                              \
+                                                                                               \
+/*Медиана трех в y*/                                                                           \
+static inline void NAME##_sort3(TYPE *x, TYPE *y, TYPE *z, mem_compare_fn_t compare)          \
+{                                                                                              \
+    (void)(compare);                                                                           \
+    TYPE t;                                                                                    \
+    if(LESS(*y, *x)){ t = *x; *x = *y; *y = t; }                                               \
+    if(LESS(*z, *y)){ t = *y; *y = *z; *z = t; }                                               \
+    if(LESS(*y, *x)){ t = *x; *x = *y; *y = t; }                                               \
+}                                                                                              \
+                                                                                               \
+static void NAME##_loop(TYPE *a, size_t n, size_t depth, bool leftmost, mem_compare_fn_t compare) \
+{                                                                                              \
+    while(n > MEMORY_SORT_SMALL){                                                              \
+        if(depth == 0){                                                                        \
+            NAME##_heap(a, n, compare);                                                        \
+            return;                                                                            \
+        }                                                                                      \
+        depth--;                                                                               \
+                                                                                               \
+        /*Опорный в a[0]*/                                                                     \
+        size_t m = n / 2;                                                                      \
+        if(n > 128){                                                                           \
+            NAME##_sort3(&a[1],     &a[m],     &a[n - 1], compare);                            \
+            NAME##_sort3(&a[2],     &a[m - 1], &a[n - 2], compare);                            \
+            NAME##_sort3(&a[3],     &a[m + 1], &a[n - 3], compare);                            \
+            NAME##_sort3(&a[m - 1], &a[m],     &a[m + 1], compare);                            \
+            TYPE t = a[0];                                                                     \
+            a[0] = a[m];                                                                       \
+            a[m] = t;                                                                          \
+        }else{                                                                                 \
+            NAME##_sort3(&a[m], &a[0], &a[n - 1], compare);                                    \
+        }                                                                                      \
+        TYPE p = a[0];                                                                         \
+                                                                                               \
+        /*Слева лежит элемент не больше всех этих, равенство с опорным: отделяем равные*/      \
+        if(!leftmost && !LESS(a[-1], p)){                                                      \
+            size_t le = 1;                                                                     \
+            for(size_t i = 1; i < n; i++){                                                     \
+                TYPE v = a[i];                                                                 \
+                a[i]  = a[le];                                                                 \
+                a[le] = v;                                                                     \
+                le += (size_t)(!LESS(p, v));                                                   \
+            }                                                                                  \
+            a += le;                                                                           \
+            n -= le;                                                                           \
+            continue;                                                                          \
+        }                                                                                      \
+                                                                                               \
+        /*[1, lt) меньше опорного, [lt, i) не меньше*/                                         \
+        size_t lt = 1;                                                                         \
+        for(size_t i = 1; i < n; i++){                                                         \
+            TYPE v = a[i];                                                                     \
+            a[i]  = a[lt];                                                                     \
+            a[lt] = v;                                                                         \
+            lt += (size_t)(LESS(v, p));                                                        \
+        }                                                                                      \
+        a[0]      = a[lt - 1];                                                                 \
+        a[lt - 1] = p;                                                                         \
+                                                                                               \
+        /*Рекурсия в меньшую часть, цикл по большей*/                                          \
+        if(lt - 1 < n - lt){                                                                   \
+            NAME##_loop(a, lt - 1, depth, leftmost, compare);                                  \
+            a += lt;                                                                           \
+            n -= lt;                                                                           \
+            leftmost = false;                                                                  \
+        }else{                                                                                 \
+            NAME##_loop(a + lt, n - lt, depth, false, compare);                                \
+            n = lt - 1;                                                                        \
+        }                                                                                      \
+    }                                                                                          \
+    NAME##_insert(a, n, compare);                                                              \
+}
+
+/*Глубина до перехода на пирамидальную: 2 * log2(n)*/
+static inline size_t memory_sort_depth(size_t count)
+{
+    return 2 * (size_t)(64 - __builtin_clzll((unsigned long long)(count) | 1ULL));
+}
+
+#define MEMORY_SORT_LESS(x, y) ((x) < (y))
+#define MEMORY_SORT_CALL(x, y) (compare(&(x), &(y)) < 0)
+
+/*Элементы фиксированного размера со сравнением через compare, копирование без memcpy по байтам.
+  Выравнивание по размеру (не больше max_align_t), чтобы копии на стеке для compare были выровнены как элементы массива*/
+#define MEMORY_SORT_ALIGN(N) (((N) < alignof(max_align_t)) ? (N) : alignof(max_align_t))
+#define MEMORY_SORT_FIXED(N) typedef struct mem_sort_##N##_t { alignas(MEMORY_SORT_ALIGN(N)) uint8_t memory_byte[N]; } mem_sort_##N##_t;
+MEMORY_SORT_FIXED(1)
+MEMORY_SORT_FIXED(2)
+MEMORY_SORT_FIXED(4)
+MEMORY_SORT_FIXED(8)
+MEMORY_SORT_FIXED(16)
+
+MEMORY_SORT_KERNEL(memory_sort_s1,  mem_sort_1_t,  MEMORY_SORT_CALL)
+MEMORY_SORT_KERNEL(memory_sort_s2,  mem_sort_2_t,  MEMORY_SORT_CALL)
+MEMORY_SORT_KERNEL(memory_sort_s4,  mem_sort_4_t,  MEMORY_SORT_CALL)
+MEMORY_SORT_KERNEL(memory_sort_s8,  mem_sort_8_t,  MEMORY_SORT_CALL)
+MEMORY_SORT_KERNEL(memory_sort_s16, mem_sort_16_t, MEMORY_SORT_CALL)
+
+/*Встроенные типы ключей без функции сравнения*/
+#define MEMORY_SORT_TYPED(NAME, TYPE)                                                          \
+MEMORY_SORT_KERNEL(memory_sort_k##NAME, TYPE, MEMORY_SORT_LESS)                                \
+bool memory_sort_##NAME(void *base, size_t count)                                              \
+{                                                                                              \
+    MEMORY_LATENCY_SCOPE(MEMORY_LATENCY_SORT);                                                 \
+                                                                                               \
+    /*Проверка, что указатели не NULL*/                                                        \
+    if(base == NULL){                                                                          \
+        return false;                                                                          \
+    }                                                                                          \
+    if(count == 0){                                                                            \
+        return false;                                                                          \
+    }                                                                                          \
+                                                                                               \
+    memory_sort_k##NAME##_loop((TYPE*)(base), count, memory_sort_depth(count), true, NULL);    \
+    return true;                                                                               \
+}
+
+MEMORY_SORT_TYPED(i8,  int8_t)
+MEMORY_SORT_TYPED(u8,  uint8_t)
+MEMORY_SORT_TYPED(i16, int16_t)
+MEMORY_SORT_TYPED(u16, uint16_t)
+MEMORY_SORT_TYPED(i32, int32_t)
+MEMORY_SORT_TYPED(u32, uint32_t)
+MEMORY_SORT_TYPED(i64, int64_t)
+MEMORY_SORT_TYPED(u64, uint64_t)
+MEMORY_SORT_TYPED(f32, float)
+MEMORY_SORT_TYPED(f64, double)
+
+bool memory_sort(void *base, size_t count, size_t size, mem_compare_fn_t compare)
+{
+    MEMORY_LATENCY_SCOPE(MEMORY_LATENCY_SORT);
+
     /*Проверка, что указатели не NULL*/
     if(base == NULL){
         return false;
     }
+    if(compare == NULL){
+        return false;
+    }
     if(count == 0){
         return false;
     }
@@ -334,28 +4001,389 @@ bool memory_shuf(void *base, size_t count, size_t size, unsigned int seed, void
         return false;
     }
 
-    if(get_rand == NULL){
-        get_rand = (mem_rand_fn_t)(rand);
+    /*Частые размеры элементов копируются целиком, остальные и невыровненный массив через qsort*/
+    size_t depth = memory_sort_depth(count);
+    switch(((uintptr_t)(base) % MEMORY_SORT_ALIGN(size) == 0) ? size : 0){
+        case 1:  memory_sort_s1_loop((mem_sort_1_t*)(base),   count, depth, true, compare); break;
+        case 2:  memory_sort_s2_loop((mem_sort_2_t*)(base),   count, depth, true, compare); break;
+        case 4:  memory_sort_s4_loop((mem_sort_4_t*)(base),   count, depth, true, compare); break;
+        case 8:  memory_sort_s8_loop((mem_sort_8_t*)(base),   count, depth, true, compare); break;
+        case 16: memory_sort_s16_loop((mem_sort_16_t*)(base), count, depth, true, compare); break;
+        default: qsort(base, count, size, compare); break;
+    }
+
+    return true;
+}
+
+/*Ключ поразрядной сортировки как беззнаковое число с тем же порядком*/
+static inline uint64_t memory_radix_key(const uint8_t *elem, size_t offset, size_t width, mem_key_t kind, mem_key_fn_t key_fn)
+{
+    if(key_fn != NULL){
+        return key_fn(elem);
+    }
+
+    uint64_t key = 0;
+    switch(width){
+        case 1:  { uint8_t  v; memcpy(&v, elem + offset, 1); key = v; break; }
+        case 2:  { uint16_t v; memcpy(&v, elem + offset, 2); key = v; break; }
+        case 4:  { uint32_t v; memcpy(&v, elem + offset, 4); key = v; break; }
+        default: { uint64_t v; memcpy(&v, elem + offset, 8); key = v; break; }
+    }
+
+    uint64_t sign = (uint64_t)(1) << (width * 8 - 1);
+    if(kind == MEMORY_KEY_INT){
+        key ^= sign;
+    }else if(kind == MEMORY_KEY_FLOAT){
+        /*Отрицательные в обратном порядке, положительные выше отрицательных*/
+        uint64_t mask = (width == 8) ? UINT64_MAX : (sign << 1) - 1;
+        key = (key & sign) ? (~key & mask) : (key | sign);
+    }
+    return key;
+}
+
+/*Один проход по байту shift, размер элемента константа после встраивания*/
+static inline __attribute__((always_inline)) void memory_radix_pass(uint8_t *dst, const uint8_t *src, size_t count, size_t size, size_t shift,
+                                                                    size_t offset, size_t width, mem_key_t kind, mem_key_fn_t key_fn, size_t pos[256])
+{
+    for(size_t i = 0; i < count; i++){
+        const uint8_t *elem = src + i * size;
+        size_t digit = (size_t)(memory_radix_key(elem, offset, width, kind, key_fn) >> shift) & 0xFF;
+        memcpy(dst + pos[digit] * size, elem, size);
+        pos[digit]++;
+    }
+}
+
+bool memory_sort_radix(
+        #if YAYA_MEMORY_STATS_USE
+        mem_stats_t *mem_stats,
+        #endif
+        void *base,
+        size_t count,
+        size_t size,
+        size_t key_offset,
+        size_t key_width,
+        mem_key_t key_kind,
+        mem_key_fn_t key_fn)
+{
+    MEMORY_LATENCY_SCOPE(MEMORY_LATENCY_SORT);
+
+    /*Проверка, что указатели не NULL*/
+    if(base == NULL){
+        return false;
+    }
+    if(count == 0){
+        return false;
+    }
+    if(size == 0){
+        return false;
     }
-    if(set_seed == NULL){
-        set_seed = (mem_seed_fn_t)(srand);
+
+    /*Ключ внутри записи и допустимой ширины*/
+    if(key_fn == NULL){
+        if(key_width != 1 && key_width != 2 && key_width != 4 && key_width != 8){
+            return false;
+        }
+        if(key_kind == MEMORY_KEY_FLOAT && key_width != 4 && key_width != 8){
+            return false;
+        }
+        if(key_offset > size || key_width > size - key_offset){
+            return false;
+        }
+    }else if(key_width == 0 || key_width > 8){
+        return false;
     }
-    set_seed(seed);
 
-    for(size_t i = 1; i < count; i++){
-        size_t r =  ((((size_t)get_rand()) % (count - i)));
-        memory_swap(base + i * size, base + r * size, size);
+    if(count == 1){
+        return true;
     }
+
+    /*Счетчики всех разрядов за один проход*/
+    size_t hist[8][256];
+    memset(hist, 0, sizeof(size_t) * 256 * key_width);
     for(size_t i = 0; i < count; i++){
-        size_t a = (((size_t)get_rand()) % (count)) ;
-        size_t b = (((size_t)get_rand()) % (count)) ;
-        memory_swap(base + a * size, base + b * size, size);
+        uint64_t key = memory_radix_key((uint8_t*)(base) + i * size, key_offset, key_width, key_kind, key_fn);
+        for(size_t d = 0; d < key_width; d++){
+            hist[d][(key >> (d * 8)) & 0xFF]++;
+        }
+    }
+
+    /*Буфер для перекладывания из memory_new, виден в статистике*/
+    uint8_t *temp = NULL;
+#if YAYA_MEMORY_STATS_USE
+    if(!memory_new(mem_stats, (void**)(&temp), NULL, count, size)){
+#else
+    if(!memory_new((void**)(&temp), NULL, count, size)){
+#endif
+        return false;
+    }
+
+    uint8_t *src = base;
+    uint8_t *dst = temp;
+    for(size_t d = 0; d < key_width; d++){
+        /*Все ключи с одинаковым байтом, проход не нужен*/
+        size_t pos[256];
+        size_t sum = 0;
+        bool skip = false;
+        for(size_t b = 0; b < 256; b++){
+            skip |= (hist[d][b] == count);
+            pos[b] = sum;
+            sum += hist[d][b];
+        }
+        if(skip){
+            continue;
+        }
+
+        switch(size){
+            case 4:  memory_radix_pass(dst, src, count, 4,    d * 8, key_offset, key_width, key_kind, key_fn, pos); break;
+            case 8:  memory_radix_pass(dst, src, count, 8,    d * 8, key_offset, key_width, key_kind, key_fn, pos); break;
+            case 16: memory_radix_pass(dst, src, count, 16,   d * 8, key_offset, key_width, key_kind, key_fn, pos); break;
+            default: memory_radix_pass(dst, src, count, size, d * 8, key_offset, key_width, key_kind, key_fn, pos); break;
+        }
+
+        uint8_t *swap = src;
+        src = dst;
+        dst = swap;
+    }
+
+    /*После нечетного числа проходов результат в буфере*/
+    if(src != base){
+        memcpy(base, src, count * size);
     }
+
+#if YAYA_MEMORY_STATS_USE
+    memory_del(mem_stats, (void**)(&temp));
+#else
+    memory_del((void**)(&temp));
+#endif
     return true;
 }
 
-bool memory_sort(void *base, size_t count, size_t size, mem_compare_fn_t compare)
+#if YAYA_MEMORY_PARALLEL_USE
+#define MEMORY_PARALLEL_MAX 256
+
+/*Задача с номером из [0, count) над общим контекстом*/
+typedef void (*mem_task_fn_t)(void *ctx, size_t task);
+
+/*Задачи раздаются потокам через общий счетчик: свободный поток берет следующую,
+  если часть потоков не создалась, остальные выполнят все задачи*/
+typedef struct mem_parallel_t {
+    mem_task_fn_t fn;
+    void         *ctx;
+    size_t        count;
+    atomic_size_t next;
+}mem_parallel_t;
+
+static void *memory_parallel_work(void *arg)
+{
+    mem_parallel_t *job = arg;
+    size_t task = atomic_fetch_add_explicit(&job->next, 1, memory_order_relaxed);
+    while(task < job->count){
+        job->fn(job->ctx, task);
+        task = atomic_fetch_add_explicit(&job->next, 1, memory_order_relaxed);
+    }
+    return NULL;
+}
+
+/*Пул рабочих на все время процесса: потоки создаются по первому запросу и ждут задание.
+  Задание одно на пул, к нему присоединяются want рабочих, после конца задания want обнуляется
+  и опоздавшие не видят задание со стека вызывающего*/
+typedef struct mem_pool_t {
+    pthread_mutex_t run;     //одно задание за раз
+    pthread_mutex_t lock;    //поля ниже
+    pthread_cond_t  wake;    //рабочие ждут новое задание
+    pthread_cond_t  done;    //вызывающий ждет рабочих
+    size_t          workers; //создано рабочих
+    size_t          epoch;   //номер задания
+    size_t          want;    //рабочих нужно заданию
+    size_t          joined;  //рабочих присоединилось
+    size_t          active;  //рабочих еще выполняют
+    mem_parallel_t *job;
+}mem_pool_t;
+
+static mem_pool_t memory_pool = {
+    .run  = PTHREAD_MUTEX_INITIALIZER,
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .wake = PTHREAD_COND_INITIALIZER,
+    .done = PTHREAD_COND_INITIALIZER,
+};
+
+static void *memory_pool_work(void *arg)
+{
+    (void)(arg);
+    mem_pool_t *pool = &memory_pool;
+    size_t seen = 0;
+
+    pthread_mutex_lock(&pool->lock);
+    seen = pool->epoch;
+    for(;;){
+        while(pool->epoch == seen){
+            pthread_cond_wait(&pool->wake, &pool->lock);
+        }
+        seen = pool->epoch;
+        if(pool->joined >= pool->want){
+            continue;
+        }
+        pool->joined++;
+        pool->active++;
+        mem_parallel_t *job = pool->job;
+
+        pthread_mutex_unlock(&pool->lock);
+        memory_parallel_work(job);
+        pthread_mutex_lock(&pool->lock);
+
+        pool->active--;
+        if(pool->active == 0){
+            pthread_cond_signal(&pool->done);
+        }
+    }
+    return NULL;
+}
+
+/*Выполнение всех задач в nthreads потоках, включая вызывающий.
+  Рабочие берутся из пула, пул занят другим вызовом - все задачи в вызывающем потоке*/
+static void memory_parallel_run(mem_task_fn_t fn, void *ctx, size_t count, size_t nthreads)
+{
+    mem_parallel_t job = {.fn = fn, .ctx = ctx, .count = count};
+    atomic_init(&job.next, 0);
+
+    mem_pool_t *pool = &memory_pool;
+    nthreads = (nthreads < count) ? nthreads : count;
+    bool shared = (nthreads > 1) && (pthread_mutex_trylock(&pool->run) == 0);
+    if(shared){
+        pthread_mutex_lock(&pool->lock);
+        while(pool->workers < nthreads - 1){
+            pthread_t thread;
+            if(pthread_create(&thread, NULL, memory_pool_work, NULL) != 0){
+                break;
+            }
+            pthread_detach(thread);
+            pool->workers++;
+        }
+        pool->job    = &job;
+        pool->want   = nthreads - 1;
+        pool->joined = 0;
+        pool->epoch++;
+        pthread_cond_broadcast(&pool->wake);
+        pthread_mutex_unlock(&pool->lock);
+    }
+
+    memory_parallel_work(&job);
+
+    if(shared){
+        pthread_mutex_lock(&pool->lock);
+        pool->want = 0;
+        while(pool->active != 0){
+            pthread_cond_wait(&pool->done, &pool->lock);
+        }
+        pool->job = NULL;
+        pthread_mutex_unlock(&pool->lock);
+        pthread_mutex_unlock(&pool->run);
+    }
+}
+
+/*Число потоков, 0 - по числу процессоров*/
+static size_t memory_parallel_threads(size_t nthreads)
+{
+    if(nthreads == 0){
+        long online = sysconf(_SC_NPROCESSORS_ONLN);
+        nthreads = (online > 0) ? (size_t)(online) : 1;
+    }
+    return (nthreads < MEMORY_PARALLEL_MAX) ? nthreads : MEMORY_PARALLEL_MAX;
+}
+
+/*Параллельная сортировка: части сортируются независимо, затем сливаются парами.
+  Каждое слияние пары делится на parts кусков выхода с границами по пути слияния*/
+typedef struct mem_sort_job_t {
+    uint8_t *src;
+    uint8_t *dst;
+    size_t   size;
+    mem_compare_fn_t compare;
+    size_t   chunk;                             //число частей
+    size_t   width;                             //частей в серии текущего круга
+    size_t   parts;                             //кусков на пару серий
+    size_t   threads;
+    size_t   bound[MEMORY_PARALLEL_MAX + 1];    //начало части в элементах
+}mem_sort_job_t;
+
+static void memory_sort_parallel_chunk(void *ctx, size_t task)
+{
+    mem_sort_job_t *job = ctx;
+    size_t beg = job->bound[task];
+    memory_sort(job->src + beg * job->size, job->bound[task + 1] - beg, job->size, job->compare);
+}
+
+/*Сколько взять из a, чтобы первые k элементов слияния a и b были готовы, при равенстве первым идет a*/
+static size_t memory_sort_corank(const uint8_t *a, size_t len_a, const uint8_t *b, size_t len_b, size_t k, size_t size, mem_compare_fn_t compare)
+{
+    size_t lo = (k > len_b) ? k - len_b : 0;
+    size_t hi = (k < len_a) ? k : len_a;
+    while(lo < hi){
+        size_t i = lo + (hi - lo) / 2;
+        if(compare(a + i * size, b + (k - i - 1) * size) <= 0){
+            lo = i + 1;
+        }else{
+            hi = i;
+        }
+    }
+    return lo;
+}
+
+static void memory_sort_parallel_merge(void *ctx, size_t task)
+{
+    mem_sort_job_t *job = ctx;
+    const size_t size = job->size;
+    mem_compare_fn_t compare = job->compare;
+
+    /*Серии пары*/
+    size_t pair = task / job->parts;
+    size_t part = task % job->parts;
+    size_t g    = pair * 2 * job->width;
+    size_t beg  = job->bound[g];
+    size_t mid  = job->bound[(g + job->width < job->chunk) ? g + job->width : job->chunk];
+    size_t end  = job->bound[(g + 2 * job->width < job->chunk) ? g + 2 * job->width : job->chunk];
+    const uint8_t *a = job->src + beg * size;
+    const uint8_t *b = job->src + mid * size;
+    size_t len_a = mid - beg;
+    size_t len_b = end - mid;
+
+    /*Свой кусок выхода*/
+    size_t k0 = (len_a + len_b) * part / job->parts;
+    size_t k1 = (len_a + len_b) * (part + 1) / job->parts;
+    size_t i  = memory_sort_corank(a, len_a, b, len_b, k0, size, compare);
+    size_t i1 = memory_sort_corank(a, len_a, b, len_b, k1, size, compare);
+    size_t j  = k0 - i;
+    size_t j1 = k1 - i1;
+    uint8_t *out = job->dst + (beg + k0) * size;
+
+    while(i < i1 && j < j1){
+        if(compare(b + j * size, a + i * size) < 0){
+            memcpy(out, b + j * size, size);
+            j++;
+        }else{
+            memcpy(out, a + i * size, size);
+            i++;
+        }
+        out += size;
+    }
+    memcpy(out, a + i * size, (i1 - i) * size);
+    out += (i1 - i) * size;
+    memcpy(out, b + j * size, (j1 - j) * size);
+}
+
+/*Возврат результата из буфера по кускам*/
+static void memory_sort_parallel_copy(void *ctx, size_t task)
 {
+    mem_sort_job_t *job = ctx;
+    size_t count = job->bound[job->chunk];
+    size_t beg = count * task / job->threads;
+    size_t end = count * (task + 1) / job->threads;
+    memcpy(job->dst + beg * job->size, job->src + beg * job->size, (end - beg) * job->size);
+}
+
+bool memory_sort_parallel(void *base, size_t count, size_t size, mem_compare_fn_t compare, size_t nthreads)
+{
+    MEMORY_LATENCY_SCOPE(MEMORY_LATENCY_SORT);
+
     /*Проверка, что указатели не NULL*/
     if(base == NULL){
         return false;
@@ -370,13 +4398,204 @@ bool memory_sort(void *base, size_t count, size_t size, mem_compare_fn_t compare
         return false;
     }
 
-    qsort(base, count, size, compare);
+    /*Малые массивы в одном потоке*/
+    nthreads = memory_parallel_threads(nthreads);
+    if(nthreads < 2 || count < YAYA_MEMORY_PARALLEL_SORT){
+        return memory_sort(base, count, size, compare);
+    }
+
+    /*Буфер для слияния целиком перезаписывается первым кругом, поэтому берется через malloc:
+      зануление в memory_new и стирание в memory_del были бы двумя лишними проходами в одном потоке.
+      Без буфера сортировка в одном потоке*/
+    uint8_t *temp = (count <= SIZE_MAX / size) ? malloc(count * size) : NULL;
+    if(temp == NULL){
+        return memory_sort(base, count, size, compare);
+    }
+
+    mem_sort_job_t job = {.src = base, .dst = temp, .size = size, .compare = compare, .chunk = nthreads, .threads = nthreads};
+    for(size_t c = 0; c <= job.chunk; c++){
+        job.bound[c] = count * c / job.chunk;
+    }
+
+    memory_parallel_run(memory_sort_parallel_chunk, &job, job.chunk, nthreads);
+
+    /*Круги слияния, на каждом работают все потоки*/
+    for(job.width = 1; job.width < job.chunk; job.width *= 2){
+        size_t pairs = (job.chunk + 2 * job.width - 1) / (2 * job.width);
+        job.parts = (nthreads + pairs - 1) / pairs;
+        memory_parallel_run(memory_sort_parallel_merge, &job, pairs * job.parts, nthreads);
+
+        uint8_t *swap = job.src;
+        job.src = job.dst;
+        job.dst = swap;
+    }
+
+    if(job.src != base){
+        job.dst = base;
+        memory_parallel_run(memory_sort_parallel_copy, &job, nthreads, nthreads);
+    }
+
+    free(temp);
+    return true;
+}
+
+/*Параллельное перемешивание разбросом по корзинам: каждый поток раскладывает свой кусок по случайным
+  корзинам в буфер, затем корзины размером с кэш перемешиваются по Фишеру-Йетсу и возвращаются на место.
+  Независимый равномерный выбор корзины и равномерная перестановка внутри нее дают равномерную перестановку
+  всего массива, все три шага делятся на задачи без последовательного слияния.
+  Генератор каждой задачи задается seed, шагом и номером, порядок не зависит от потоков*/
+typedef struct mem_shuf_job_t {
+    uint8_t *base;
+    uint8_t *temp;
+    size_t   count;
+    size_t   size;
+    size_t   chunk;   //кусков входа, по одному на поток
+    size_t   bucket;  //число корзин
+    size_t  *place;   //chunk * bucket: сколько кусок кладет в корзину, затем куда кладет следующий
+    size_t  *bound;   //bucket + 1 начал корзин в буфере
+    uint64_t seed;
+}mem_shuf_job_t;
+
+static inline size_t memory_shuf_bound(const mem_shuf_job_t *job, size_t c)
+{
+    return (size_t)((__uint128_t)(job->count) * c / job->chunk);
+}
+
+/*Независимое состояние wyrand через splitmix64*/
+static inline mem_rand_t memory_shuf_rng(uint64_t seed, size_t round, size_t task)
+{
+    uint64_t z = seed ^ ((uint64_t)(round) << 56) ^ (uint64_t)(task);
+    z += 0x9e3779b97f4a7c15ULL;
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    z ^= (z >> 31);
+    return (mem_rand_t){.state = z, .get_rand = NULL};
+}
+
+/*Подсчет, сколько элементов куска попадет в каждую корзину*/
+static void memory_shuf_parallel_count(void *ctx, size_t task)
+{
+    mem_shuf_job_t *job = ctx;
+    size_t len = memory_shuf_bound(job, task + 1) - memory_shuf_bound(job, task);
+    size_t *place = job->place + task * job->bucket;
+    mem_rand_t rng = memory_shuf_rng(job->seed, 0, task);
+    for(size_t i = 0; i < len; i++){
+        place[memory_rand_bound(&rng, job->bucket)]++;
+    }
+}
+
+/*Раскладка куска в буфер, генератор повторяет выбор корзин из подсчета*/
+static inline __attribute__((always_inline)) void memory_shuf_scatter_pass(const uint8_t *src, size_t len, uint8_t *dst, size_t *place, size_t bucket, size_t size, mem_rand_t *rng)
+{
+    for(size_t i = 0; i < len; i++){
+        size_t b = memory_rand_bound(rng, bucket);
+        memcpy(dst + place[b] * size, src + i * size, size);
+        place[b]++;
+    }
+}
+
+static void memory_shuf_parallel_scatter(void *ctx, size_t task)
+{
+    mem_shuf_job_t *job = ctx;
+    size_t beg = memory_shuf_bound(job, task);
+    size_t len = memory_shuf_bound(job, task + 1) - beg;
+    size_t *place = job->place + task * job->bucket;
+    mem_rand_t rng = memory_shuf_rng(job->seed, 0, task);
+    uint8_t *src = job->base + beg * job->size;
+    switch(job->size){
+        case 1:  memory_shuf_scatter_pass(src, len, job->temp, place, job->bucket, 1,         &rng); break;
+        case 2:  memory_shuf_scatter_pass(src, len, job->temp, place, job->bucket, 2,         &rng); break;
+        case 4:  memory_shuf_scatter_pass(src, len, job->temp, place, job->bucket, 4,         &rng); break;
+        case 8:  memory_shuf_scatter_pass(src, len, job->temp, place, job->bucket, 8,         &rng); break;
+        case 16: memory_shuf_scatter_pass(src, len, job->temp, place, job->bucket, 16,        &rng); break;
+        default: memory_shuf_scatter_pass(src, len, job->temp, place, job->bucket, job->size, &rng); break;
+    }
+}
+
+/*Перемешивание корзины в буфере и возврат на то же место массива*/
+static void memory_shuf_parallel_bucket(void *ctx, size_t task)
+{
+    mem_shuf_job_t *job = ctx;
+    size_t beg = job->bound[task];
+    size_t len = job->bound[task + 1] - beg;
+    uint8_t *temp = job->temp + beg * job->size;
+    if(len > 1){
+        mem_rand_t rng = memory_shuf_rng(job->seed, 1, task);
+        switch(job->size){
+            case 1:  memory_shuf_pass(temp, len, 1,         &rng); break;
+            case 2:  memory_shuf_pass(temp, len, 2,         &rng); break;
+            case 4:  memory_shuf_pass(temp, len, 4,         &rng); break;
+            case 8:  memory_shuf_pass(temp, len, 8,         &rng); break;
+            case 16: memory_shuf_pass(temp, len, 16,        &rng); break;
+            default: memory_shuf_pass(temp, len, job->size, &rng); break;
+        }
+    }
+    memcpy(job->base + beg * job->size, temp, len * job->size);
+}
+
+bool memory_shuf_parallel(void *base, size_t count, size_t size, unsigned int seed, size_t nthreads)
+{
+    /*Проверка, что указатели не NULL*/
+    if(base == NULL){
+        return false;
+    }
+    if(count == 0){
+        return false;
+    }
+    if(size == 0){
+        return false;
+    }
+
+    /*Малые массивы обычным перемешиванием*/
+    if(count < YAYA_MEMORY_PARALLEL_SHUF){
+        return memory_shuf(base, count, size, seed, NULL, NULL);
+    }
+    MEMORY_LATENCY_SCOPE(MEMORY_LATENCY_SHUF);
+
+    /*Корзин не меньше потоков и не больше YAYA_MEMORY_PARALLEL_BLOCK байт в корзине в среднем*/
+    nthreads = memory_parallel_threads(nthreads);
+    size_t bucket = (size_t)((__uint128_t)(count) * size / YAYA_MEMORY_PARALLEL_BLOCK) + 1;
+    mem_shuf_job_t job = {.base = base, .count = count, .size = size, .chunk = nthreads, .seed = seed};
+    job.bucket = (bucket > nthreads) ? bucket : nthreads;
+
+    /*Буфер целиком перезаписывается раскладкой, поэтому через malloc, как в memory_sort_parallel.
+      Без буфера перемешивание в одном потоке*/
+    job.temp  = (count <= SIZE_MAX / size) ? malloc(count * size) : NULL;
+    job.place = calloc(job.chunk * job.bucket + job.bucket + 1, sizeof(size_t));
+    if(job.temp == NULL || job.place == NULL){
+        free(job.temp);
+        free(job.place);
+        return memory_shuf(base, count, size, seed, NULL, NULL);
+    }
+    job.bound = job.place + job.chunk * job.bucket;
+
+    memory_parallel_run(memory_shuf_parallel_count, &job, job.chunk, nthreads);
 
+    /*Корзины идут подряд, внутри корзины куски по порядку*/
+    size_t total = 0;
+    for(size_t b = 0; b < job.bucket; b++){
+        job.bound[b] = total;
+        for(size_t c = 0; c < job.chunk; c++){
+            size_t n = job.place[c * job.bucket + b];
+            job.place[c * job.bucket + b] = total;
+            total += n;
+        }
+    }
+    job.bound[job.bucket] = total;
+
+    memory_parallel_run(memory_shuf_parallel_scatter, &job, job.chunk, nthreads);
+    memory_parallel_run(memory_shuf_parallel_bucket, &job, job.bucket, nthreads);
+
+    free(job.temp);
+    free(job.place);
     return true;
 }
+#endif /*YAYA_MEMORY_PARALLEL_USE*/
 
 bool memory_bsearch(void **search_res, void *key, void *base, size_t count, size_t size, mem_compare_fn_t compare)
 {
+    MEMORY_LATENCY_SCOPE(MEMORY_LATENCY_SEARCH);
+
     /*Проверка, что указатели не NULL*/
     if(search_res == NULL){
         return false;
@@ -404,6 +4623,8 @@ bool memory_bsearch(void **search_res, void *key, void *base, size_t count, size
 
 bool memory_rsearch(void** search_res, void *key, void *base, size_t count, size_t size, mem_compare_fn_t compare)
 {
+    MEMORY_LATENCY_SCOPE(MEMORY_LATENCY_SEARCH);
+
     /*Проверка, что указатели не NULL*/
     if(search_res == NULL){
         return false;
@@ -448,7 +4669,10 @@ bool memory_dump(void *ptr, size_t len, uintmax_t catbyte, uintmax_t column)
 
     if(len == 0){
         mem_info_t *mem = NULL;
-        mem = ptr - offsetof(mem_info_t, memory_ptr);
+        mem = memory_info(ptr);
+        if(mem == NULL){
+            return false;
+        }
         ptr = mem->memory_ptr;
         len = mem->memory_request;
     }
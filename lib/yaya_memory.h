@@ -12,6 +12,7 @@
 #include "stdint.h"
 #include "stdbool.h"
 #include "stddef.h"
+#include "stdio.h"
 
 #ifndef YAYA_MEMORY_STATS_USE
 #   define YAYA_MEMORY_STATS_USE 0
@@ -27,6 +28,20 @@
 #   endif /*YAYA_MEMORY_STATS_GLOBAL*/
 #endif /*YAYA_MEMORY_STATS_USE*/
 
+#if YAYA_MEMORY_STATS_USE
+#   ifndef YAYA_MEMORY_STATS_SHARD
+#       define YAYA_MEMORY_STATS_SHARD 0 /*число счетчиков по потокам*/
+#   endif /*YAYA_MEMORY_STATS_SHARD*/
+
+#   ifndef YAYA_MEMORY_STATS_BUCKET
+#       define YAYA_MEMORY_STATS_BUCKET 64 /*корзин гистограмм по степеням двойки*/
+#   endif /*YAYA_MEMORY_STATS_BUCKET*/
+
+#   ifndef YAYA_MEMORY_STATS_REPORT
+#       define YAYA_MEMORY_STATS_REPORT 0 /*периодический вывод статистики в потоке pthread*/
+#   endif /*YAYA_MEMORY_STATS_REPORT*/
+#endif /*YAYA_MEMORY_STATS_USE*/
+
 #ifndef YAYA_MEMORY_MACRO_DEF
 #   define YAYA_MEMORY_MACRO_DEF 0
 #endif /*YAYA_MEMORY_MACRO_DEF*/
@@ -39,6 +54,230 @@
 #   define YAYA_MEMORY_VALUE_AFTER_MEM 0x88
 #endif /*YAYA_MEMORY_VALUE_AFTER_MEM*/
 
+/*Порог затирания памяти в байтах, начиная с которого запись идет мимо кэша*/
+#ifndef YAYA_MEMORY_WIPE_STREAM
+#   define YAYA_MEMORY_WIPE_STREAM 4194304
+#endif /*YAYA_MEMORY_WIPE_STREAM*/
+
+/*Запас емкости при росте блока через memory_new в процентах*/
+#ifndef YAYA_MEMORY_GROWTH
+#   define YAYA_MEMORY_GROWTH 50
+#endif /*YAYA_MEMORY_GROWTH*/
+
+/*Выдача малых блоков из слябов вместо malloc*/
+#ifndef YAYA_MEMORY_SLAB_USE
+#   define YAYA_MEMORY_SLAB_USE 0
+#endif /*YAYA_MEMORY_SLAB_USE*/
+
+/*Размер одного сляба в байтах*/
+#ifndef YAYA_MEMORY_SLAB_PAGE
+#   define YAYA_MEMORY_SLAB_PAGE 65536
+#endif /*YAYA_MEMORY_SLAB_PAGE*/
+
+/*Классы размеров запроса в байтах, по возрастанию*/
+#ifndef YAYA_MEMORY_SLAB_CLASS
+#   define YAYA_MEMORY_SLAB_CLASS 16, 32, 48, 64, 96, 128, 192, 256
+#endif /*YAYA_MEMORY_SLAB_CLASS*/
+
+/*Выделение из арены с освобождением всех блоков разом*/
+#ifndef YAYA_MEMORY_ARENA_USE
+#   define YAYA_MEMORY_ARENA_USE 0
+#endif /*YAYA_MEMORY_ARENA_USE*/
+
+/*Размер куска арены по умолчанию в байтах*/
+#ifndef YAYA_MEMORY_ARENA_CHUNK
+#   define YAYA_MEMORY_ARENA_CHUNK 65536
+#endif /*YAYA_MEMORY_ARENA_CHUNK*/
+
+/*Выделение больших блоков через mmap, страницы приходят зануленными*/
+#ifndef YAYA_MEMORY_MMAP_USE
+#   define YAYA_MEMORY_MMAP_USE 0
+#endif /*YAYA_MEMORY_MMAP_USE*/
+
+/*Порог размера блока вместе с заголовком для mmap в байтах*/
+#ifndef YAYA_MEMORY_MMAP_SIZE
+#   define YAYA_MEMORY_MMAP_SIZE 1048576
+#endif /*YAYA_MEMORY_MMAP_SIZE*/
+
+/*Большие блоки на больших страницах: hugetlbfs или MADV_HUGEPAGE*/
+#ifndef YAYA_MEMORY_HUGE_USE
+#   define YAYA_MEMORY_HUGE_USE 0
+#endif /*YAYA_MEMORY_HUGE_USE*/
+
+/*Порог размера блока вместе с заголовком для больших страниц в байтах*/
+#ifndef YAYA_MEMORY_HUGE_SIZE
+#   define YAYA_MEMORY_HUGE_SIZE 2097152
+#endif /*YAYA_MEMORY_HUGE_SIZE*/
+
+/*Размер большой страницы в байтах, степень двойки*/
+#ifndef YAYA_MEMORY_HUGE_PAGE
+#   define YAYA_MEMORY_HUGE_PAGE 2097152
+#endif /*YAYA_MEMORY_HUGE_PAGE*/
+
+#if YAYA_MEMORY_HUGE_USE && !YAYA_MEMORY_MMAP_USE
+#   error "YAYA_MEMORY_HUGE_USE requires YAYA_MEMORY_MMAP_USE"
+#endif
+
+/*Выделение с выравниванием больше max_align_t*/
+#ifndef YAYA_MEMORY_ALIGN_USE
+#   define YAYA_MEMORY_ALIGN_USE 0
+#endif /*YAYA_MEMORY_ALIGN_USE*/
+
+/*Учет памяти по местам вызова mem_new*/
+#ifndef YAYA_MEMORY_SITE_USE
+#   define YAYA_MEMORY_SITE_USE 0
+#endif /*YAYA_MEMORY_SITE_USE*/
+
+/*Наибольшее число мест вызова в таблице*/
+#ifndef YAYA_MEMORY_SITE_COUNT
+#   define YAYA_MEMORY_SITE_COUNT 4096
+#endif /*YAYA_MEMORY_SITE_COUNT*/
+
+/*Выборочный профиль кучи: стек вызова для одного блока в среднем на шаг выборки*/
+#ifndef YAYA_MEMORY_SAMPLE_USE
+#   define YAYA_MEMORY_SAMPLE_USE 0
+#endif /*YAYA_MEMORY_SAMPLE_USE*/
+
+/*Средний шаг выборки в байтах при запуске, 0 - выборка выключена*/
+#ifndef YAYA_MEMORY_SAMPLE_RATE
+#   define YAYA_MEMORY_SAMPLE_RATE 524288
+#endif /*YAYA_MEMORY_SAMPLE_RATE*/
+
+/*Наибольшая глубина сохраняемого стека*/
+#ifndef YAYA_MEMORY_SAMPLE_DEPTH
+#   define YAYA_MEMORY_SAMPLE_DEPTH 32
+#endif /*YAYA_MEMORY_SAMPLE_DEPTH*/
+
+/*Число записей таблицы живых выбранных блоков, степень двойки*/
+#ifndef YAYA_MEMORY_SAMPLE_COUNT
+#   define YAYA_MEMORY_SAMPLE_COUNT 4096
+#endif /*YAYA_MEMORY_SAMPLE_COUNT*/
+
+#if YAYA_MEMORY_SAMPLE_USE && (YAYA_MEMORY_SAMPLE_COUNT & (YAYA_MEMORY_SAMPLE_COUNT - 1))
+#   error "YAYA_MEMORY_SAMPLE_COUNT must be a power of two"
+#endif
+
+/*Гистограммы времени вызовов по потокам: new, res, del, sort, search*/
+#ifndef YAYA_MEMORY_LATENCY_USE
+#   define YAYA_MEMORY_LATENCY_USE 0
+#endif /*YAYA_MEMORY_LATENCY_USE*/
+
+/*Учет всех живых блоков для отчета об утечках*/
+#ifndef YAYA_MEMORY_LIVE_USE
+#   define YAYA_MEMORY_LIVE_USE 0
+#endif /*YAYA_MEMORY_LIVE_USE*/
+
+/*Число записей таблицы живых блоков, степень двойки*/
+#ifndef YAYA_MEMORY_LIVE_COUNT
+#   define YAYA_MEMORY_LIVE_COUNT 1048576
+#endif /*YAYA_MEMORY_LIVE_COUNT*/
+
+#if YAYA_MEMORY_LIVE_USE && (YAYA_MEMORY_LIVE_COUNT & (YAYA_MEMORY_LIVE_COUNT - 1))
+#   error "YAYA_MEMORY_LIVE_COUNT must be a power of two"
+#endif
+
+/*Проверка хвоста блока за запрошенным, заполненного YAYA_MEMORY_VALUE_AFTER_MEM*/
+#ifndef YAYA_MEMORY_CHECK_USE
+#   define YAYA_MEMORY_CHECK_USE 0
+#endif /*YAYA_MEMORY_CHECK_USE*/
+
+/*Сколько байт хвоста проверяется, 0 - весь хвост*/
+#ifndef YAYA_MEMORY_CHECK_SIZE
+#   define YAYA_MEMORY_CHECK_SIZE 4096
+#endif /*YAYA_MEMORY_CHECK_SIZE*/
+
+/*Аварийное завершение после отчета о выходе за границу блока*/
+#ifndef YAYA_MEMORY_CHECK_ABORT
+#   define YAYA_MEMORY_CHECK_ABORT 0
+#endif /*YAYA_MEMORY_CHECK_ABORT*/
+
+/*Большие блоки через mmap концом к странице без доступа*/
+#ifndef YAYA_MEMORY_CHECK_GUARD
+#   define YAYA_MEMORY_CHECK_GUARD 0
+#endif /*YAYA_MEMORY_CHECK_GUARD*/
+
+#if YAYA_MEMORY_CHECK_GUARD && !YAYA_MEMORY_MMAP_USE
+#   error "YAYA_MEMORY_CHECK_GUARD requires YAYA_MEMORY_MMAP_USE"
+#endif
+
+/*Отложенное освобождение: затертые блоки ждут в очереди потока и проверяются при выходе из нее*/
+#ifndef YAYA_MEMORY_QUARANTINE_USE
+#   define YAYA_MEMORY_QUARANTINE_USE 0
+#endif /*YAYA_MEMORY_QUARANTINE_USE*/
+
+/*Наибольший объем блоков в очереди одного потока в байтах*/
+#ifndef YAYA_MEMORY_QUARANTINE_SIZE
+#   define YAYA_MEMORY_QUARANTINE_SIZE 1048576
+#endif /*YAYA_MEMORY_QUARANTINE_SIZE*/
+
+/*Наибольшее число блоков в очереди одного потока*/
+#ifndef YAYA_MEMORY_QUARANTINE_COUNT
+#   define YAYA_MEMORY_QUARANTINE_COUNT 4096
+#endif /*YAYA_MEMORY_QUARANTINE_COUNT*/
+
+/*Теги подсистем в заголовке блока со счетчиками и бюджетами*/
+#ifndef YAYA_MEMORY_TAG_USE
+#   define YAYA_MEMORY_TAG_USE 0
+#endif /*YAYA_MEMORY_TAG_USE*/
+
+/*Число тегов, не больше 65536*/
+#ifndef YAYA_MEMORY_TAG_COUNT
+#   define YAYA_MEMORY_TAG_COUNT 256
+#endif /*YAYA_MEMORY_TAG_COUNT*/
+
+#if YAYA_MEMORY_TAG_USE && (YAYA_MEMORY_TAG_COUNT > 65536)
+#   error "YAYA_MEMORY_TAG_COUNT must not exceed 65536"
+#endif
+
+/*Многопоточные сортировка и перемешивание*/
+#ifndef YAYA_MEMORY_PARALLEL_USE
+#   define YAYA_MEMORY_PARALLEL_USE 0
+#endif /*YAYA_MEMORY_PARALLEL_USE*/
+
+/*Меньше элементов сортируются в одном потоке*/
+#ifndef YAYA_MEMORY_PARALLEL_SORT
+#   define YAYA_MEMORY_PARALLEL_SORT 65536
+#endif /*YAYA_MEMORY_PARALLEL_SORT*/
+
+/*Меньше элементов перемешиваются в одном потоке*/
+#ifndef YAYA_MEMORY_PARALLEL_SHUF
+#   define YAYA_MEMORY_PARALLEL_SHUF 65536
+#endif /*YAYA_MEMORY_PARALLEL_SHUF*/
+
+/*Наибольший блок параллельного перемешивания в байтах, помещается в кэш*/
+#ifndef YAYA_MEMORY_PARALLEL_BLOCK
+#   define YAYA_MEMORY_PARALLEL_BLOCK 1048576
+#endif /*YAYA_MEMORY_PARALLEL_BLOCK*/
+
+/*Заголовок хранит источник блока*/
+#if YAYA_MEMORY_SLAB_USE || YAYA_MEMORY_ARENA_USE || YAYA_MEMORY_MMAP_USE || YAYA_MEMORY_ALIGN_USE || YAYA_MEMORY_SITE_USE || YAYA_MEMORY_SAMPLE_USE || YAYA_MEMORY_TAG_USE
+#   define YAYA_MEMORY_INFO_FLAGS 1
+#else
+#   define YAYA_MEMORY_INFO_FLAGS 0
+#endif /*YAYA_MEMORY_INFO_FLAGS*/
+
+/*Хранение сведений о блоке:
+  0 - заголовок перед памятью, память выровнена на max_align_t;
+  1 - сжатый заголовок из одного size_t, выданное берется у malloc_usable_size,
+      память выровнена на size_t;
+  2 - заголовка нет, сведения лежат во внешней таблице по указателю*/
+#ifndef YAYA_MEMORY_INFO_MODE
+#   define YAYA_MEMORY_INFO_MODE 0
+#endif /*YAYA_MEMORY_INFO_MODE*/
+
+/*Число записей внешней таблицы, степень двойки*/
+#ifndef YAYA_MEMORY_INFO_SIDE
+#   define YAYA_MEMORY_INFO_SIDE 1048576
+#endif /*YAYA_MEMORY_INFO_SIDE*/
+
+#if YAYA_MEMORY_INFO_MODE && YAYA_MEMORY_INFO_FLAGS
+#   error "YAYA_MEMORY_INFO_MODE is only supported with SLAB, ARENA, MMAP, ALIGN, SITE, SAMPLE and TAG disabled"
+#endif
+
+#if YAYA_MEMORY_INFO_MODE == 2 && (YAYA_MEMORY_INFO_SIDE & (YAYA_MEMORY_INFO_SIDE - 1))
+#   error "YAYA_MEMORY_INFO_SIDE must be a power of two"
+#endif
+
 #if YAYA_MEMORY_STATS_USE
 typedef struct mem_stats_t {
     size_t memory_request;  //запросил
@@ -47,36 +286,237 @@ typedef struct mem_stats_t {
     size_t memory_call_new; //фактически выдано
     size_t memory_call_res; //фактически перераспределено
     size_t memory_call_del; //фактически удалено
+    size_t memory_header;   //занято заголовками живых блоков
+    size_t memory_peak;     //наибольшее занятое
+    size_t memory_mark;     //наибольшее занятое с последнего memory_stats_mark
+    size_t memory_hist_sum; //сумма размеров запросов из memory_hist_request
+    size_t memory_hist_request[YAYA_MEMORY_STATS_BUCKET]; //запросов по размеру, корзина i для [2^(i-1), 2^i)
+    size_t memory_hist_live[YAYA_MEMORY_STATS_BUCKET];    //живых запрошенных байт по размеру блока
+#if YAYA_MEMORY_HUGE_USE
+    size_t memory_huge;     //занято блоками на больших страницах
+#endif /*YAYA_MEMORY_HUGE_USE*/
+#if YAYA_MEMORY_STATS_SHARD
+    size_t memory_live;     //занятое всеми потоками для пика, общий атомарный счетчик
+    struct mem_stats_shard_t *memory_shard; //счетчики потоков из memory_stats_init, без них счет в поля в одном потоке
+#endif /*YAYA_MEMORY_STATS_SHARD*/
 }mem_stats_t;
 
 #if YAYA_MEMORY_STATS_USE && YAYA_MEMORY_STATS_GLOBAL
 extern mem_stats_t mem_stats;
 #endif /*YAYA_MEMORY_STATS_GLOBAL*/
 
+/*Форматы выгрузки статистики*/
+typedef enum mem_format_t {
+    MEMORY_FORMAT_JSON,     //один объект JSON
+    MEMORY_FORMAT_CSV_HEAD, //строка заголовков CSV
+    MEMORY_FORMAT_CSV,      //строка значений CSV
+    MEMORY_FORMAT_PROM,     //текстовый формат Prometheus
+}mem_format_t;
+
+#if YAYA_MEMORY_STATS_REPORT
+typedef struct mem_report_t mem_report_t;
+#endif /*YAYA_MEMORY_STATS_REPORT*/
+
 #if YAYA_MEMORY_STATS_OFF
 #define memory_stats_init(A) true
 #define memory_stats_free(A) true
 #define memory_stats_show(A) true
+#define memory_stats_snapshot(A, B) true
+#define memory_stats_mark(A) true
+#define memory_stats_diff(B, E, D) true
+#define memory_stats_export(A, F, B, L) ((size_t)(0))
+#define memory_stats_write(A, F, O) true
+#if YAYA_MEMORY_STATS_REPORT
+#define memory_stats_report_start(R, A, F, O, P) true
+#define memory_stats_report_stop(R) true
+#endif /*YAYA_MEMORY_STATS_REPORT*/
 #else
 bool memory_stats_init(mem_stats_t **mem_stats);
 bool memory_stats_free(mem_stats_t **mem_stats);
 bool memory_stats_show(mem_stats_t *mem_stats);
+/*Снимок счетчиков без изменения mem_stats*/
+bool memory_stats_snapshot(mem_stats_t *mem_stats, mem_stats_t *snapshot);
+/*Начало области: memory_mark дальше считается от занятого сейчас. Метка одна на mem_stats,
+  вложенная область перезапускает пик внешней*/
+bool memory_stats_mark(mem_stats_t *mem_stats);
+/*Разность двух снимков: вызовы и байты за область, memory_peak - подъем занятого выше начала области.
+  Для занятого (header, hist_live, huge) уменьшение дает отрицательное значение через (intptr_t)*/
+bool memory_stats_diff(const mem_stats_t *begin, const mem_stats_t *end, mem_stats_t *diff);
+/*Выгрузка в буфер как snprintf: возвращает полную длину без нуля, пишет не больше len*/
+size_t memory_stats_export(mem_stats_t *mem_stats, mem_format_t format, char *buf, size_t len);
+bool memory_stats_write(mem_stats_t *mem_stats, mem_format_t format, FILE *file);
+#if YAYA_MEMORY_STATS_REPORT
+/*Вывод в file каждые period_ms миллисекунд, для CSV заголовок пишется один раз*/
+bool memory_stats_report_start(mem_report_t **report, mem_stats_t *mem_stats, mem_format_t format, FILE *file, size_t period_ms);
+bool memory_stats_report_stop(mem_report_t **report);
+#endif /*YAYA_MEMORY_STATS_REPORT*/
 #endif /*YAYA_MEMORY_STATS_OFF*/
 #endif /*YAYA_MEMORY_STATS_USE*/
 
+#if YAYA_MEMORY_INFO_MODE == 1
+typedef struct mem_info_t {
+    size_t memory_request;                       //запросили
+    alignas(size_t) uint8_t  memory_ptr[];       //указатель на начало
+}mem_info_t;
+#elif YAYA_MEMORY_INFO_MODE == 2
 typedef struct mem_info_t {
     size_t memory_request;                       //запросили
     size_t memory_produce;                       //выдали
+    uint8_t *memory_ptr;                         //указатель на начало, ключ таблицы
+}mem_info_t;
+#else
+typedef struct mem_info_t {
+    size_t memory_request;                       //запросили
+    size_t memory_produce;                       //выдали
+#if YAYA_MEMORY_INFO_FLAGS
+    size_t memory_flags;                         //источник блока
+#endif /*YAYA_MEMORY_INFO_FLAGS*/
     alignas(max_align_t) uint8_t  memory_ptr[];  //указатель на начало
 }mem_info_t;
+#endif /*YAYA_MEMORY_INFO_MODE*/
 
+/*memory_new_batch и memory_del_batch: блоки выдаются и освобождаются по одному, как у memory_new и memory_del.
+  Одной операцией над источником пачка идет только через slab, одна блокировка на класс;
+  без slab экономится лишь проверка аргументов, бюджет тега и одно обновление статистики*/
 #if YAYA_MEMORY_STATS_USE
 bool   memory_new(mem_stats_t *mem_stats, void **ptr, void *old_ptr, const size_t count, const size_t size);
+bool   memory_reserve(mem_stats_t *mem_stats, void **ptr, const size_t count, const size_t size);
 bool   memory_del(mem_stats_t *mem_stats, void **ptr);
+bool   memory_new_batch(mem_stats_t *mem_stats, void **ptrs, const size_t count, const size_t size);
+bool   memory_del_batch(mem_stats_t *mem_stats, void **ptrs, const size_t count);
 #else
 bool   memory_new(void **ptr, void *old_ptr, const size_t count, const size_t size);
+bool   memory_reserve(void **ptr, const size_t count, const size_t size);
 bool   memory_del(void **ptr);
+bool   memory_new_batch(void **ptrs, const size_t count, const size_t size);
+bool   memory_del_batch(void **ptrs, const size_t count);
+#endif /*YAYA_MEMORY_STATS_USE*/
+
+#if YAYA_MEMORY_ALIGN_USE
+#if YAYA_MEMORY_STATS_USE
+bool   memory_new_aligned(mem_stats_t *mem_stats, void **ptr, const size_t count, const size_t size, const size_t align);
+#else
+bool   memory_new_aligned(void **ptr, const size_t count, const size_t size, const size_t align);
+#endif /*YAYA_MEMORY_STATS_USE*/
+#endif /*YAYA_MEMORY_ALIGN_USE*/
+
+#if YAYA_MEMORY_ARENA_USE
+typedef struct mem_arena_t mem_arena_t;
+
+bool   memory_arena_init(mem_arena_t **arena, size_t chunk);
+#if YAYA_MEMORY_STATS_USE
+bool   memory_arena_free(mem_stats_t *mem_stats, mem_arena_t **arena);
+bool   memory_arena_new(mem_stats_t *mem_stats, mem_arena_t *arena, void **ptr, void *old_ptr, const size_t count, const size_t size);
+bool   memory_arena_reset(mem_stats_t *mem_stats, mem_arena_t *arena);
+#else
+bool   memory_arena_free(mem_arena_t **arena);
+bool   memory_arena_new(mem_arena_t *arena, void **ptr, void *old_ptr, const size_t count, const size_t size);
+bool   memory_arena_reset(mem_arena_t *arena);
 #endif /*YAYA_MEMORY_STATS_USE*/
+#endif /*YAYA_MEMORY_ARENA_USE*/
+
+#if YAYA_MEMORY_SITE_USE
+/*Место вызова, создается макросом mem_new, счетчики меняются атомарно*/
+typedef struct mem_site_t {
+    const char *memory_file;  //файл
+    const char *memory_func;  //функция
+    size_t memory_line;       //строка
+    size_t memory_index;      //номер в таблице с единицы, 0 до первого вызова
+    size_t memory_call;       //вызовов memory_new
+    size_t memory_request;    //запрошено всего
+    size_t memory_live;       //запрошено живыми блоками
+}mem_site_t;
+
+#if YAYA_MEMORY_STATS_USE
+bool   memory_new_site(mem_stats_t *mem_stats, mem_site_t *site, void **ptr, void *old_ptr, const size_t count, const size_t size);
+#else
+bool   memory_new_site(mem_site_t *site, void **ptr, void *old_ptr, const size_t count, const size_t size);
+#endif /*YAYA_MEMORY_STATS_USE*/
+size_t memory_site_top(mem_site_t *sites, size_t count);
+bool   memory_site_show(size_t count);
+#endif /*YAYA_MEMORY_SITE_USE*/
+
+#if YAYA_MEMORY_SAMPLE_USE
+/*Средний шаг выборки в байтах, 0 выключает выборку.
+  В других потоках новый шаг действует после их следующей выборки*/
+bool   memory_sample_rate(size_t rate);
+size_t memory_sample_count(void);
+/*Живые выбранные блоки в текстовом формате heap profile, читается pprof*/
+bool   memory_sample_dump(FILE *file);
+#endif /*YAYA_MEMORY_SAMPLE_USE*/
+
+#if YAYA_MEMORY_LATENCY_USE
+/*Виды замеряемых вызовов*/
+typedef enum mem_latency_kind_t {
+    MEMORY_LATENCY_NEW,    //memory_new без old_ptr и memory_new_aligned
+    MEMORY_LATENCY_RES,    //memory_new с old_ptr и memory_reserve
+    MEMORY_LATENCY_DEL,    //memory_del
+    MEMORY_LATENCY_SORT,   //memory_sort
+    MEMORY_LATENCY_SEARCH, //memory_bsearch и memory_rsearch
+    MEMORY_LATENCY_SHUF,   //memory_shuf и memory_shuf_parallel
+    MEMORY_LATENCY_KIND,
+}mem_latency_kind_t;
+
+/*Сводка по всем потокам в наносекундах, точность корзин около 3%*/
+typedef struct mem_latency_t {
+    size_t   memory_count; //вызовов
+    uint64_t memory_p50;
+    uint64_t memory_p99;
+    uint64_t memory_p999;
+    uint64_t memory_max;
+}mem_latency_t;
+
+bool   memory_latency_get(mem_latency_kind_t kind, mem_latency_t *latency);
+bool   memory_latency_show(void);
+bool   memory_latency_reset(void);
+#endif /*YAYA_MEMORY_LATENCY_USE*/
+
+#if YAYA_MEMORY_LIVE_USE
+size_t memory_live_count(void);
+/*Блоков, не учтенных из-за заполненной таблицы YAYA_MEMORY_LIVE_COUNT, отчет их не видит*/
+size_t memory_live_dropped(void);
+/*Отчет по живым блокам: размер, возраст, место вызова и первые head байт через memory_dump.
+  Вызывается, когда другие потоки не освобождают память*/
+bool   memory_live_show(size_t head);
+/*Отчет при выходе из программы, если остались живые блоки*/
+bool   memory_live_atexit(size_t head);
+#endif /*YAYA_MEMORY_LIVE_USE*/
+
+#if YAYA_MEMORY_CHECK_USE
+/*Проверка хвоста блока, при порче печатается отчет и возвращается false*/
+bool   memory_check(void *ptr);
+#if YAYA_MEMORY_LIVE_USE
+/*Проверка всех живых блоков, возвращает число испорченных*/
+size_t memory_check_all(void);
+#endif /*YAYA_MEMORY_LIVE_USE*/
+#endif /*YAYA_MEMORY_CHECK_USE*/
+
+#if YAYA_MEMORY_QUARANTINE_USE
+/*Освобождение всех блоков из очереди вызывающего потока, false при найденной записи в освобожденное*/
+bool   memory_quarantine_flush(void);
+#endif /*YAYA_MEMORY_QUARANTINE_USE*/
+
+#if YAYA_MEMORY_TAG_USE
+/*Вызывается при выделении сверх мягкого бюджета, live уже включает request*/
+typedef void (*mem_tag_fn_t)(size_t tag, size_t live, size_t request);
+
+/*Счетчики тега, учитываются запрошенные байты*/
+typedef struct mem_tag_t {
+    size_t memory_live;            //запрошено живыми блоками
+    size_t memory_call;            //выделений и ростов с тегом
+    size_t memory_fail;            //отказов по жесткому бюджету
+    size_t memory_soft;            //мягкий бюджет, 0 - нет
+    size_t memory_hard;            //жесткий бюджет, 0 - нет
+    mem_tag_fn_t memory_callback;  //вызов сверх мягкого бюджета
+}mem_tag_t;
+
+/*Тег новых блоков в вызывающем потоке, возвращает прежний или SIZE_MAX при неверном теге.
+  Рост блока учитывается по тегу самого блока*/
+size_t memory_tag_set(size_t tag);
+bool   memory_tag_budget(size_t tag, size_t soft, size_t hard, mem_tag_fn_t callback);
+bool   memory_tag_get(size_t tag, mem_tag_t *info);
+bool   memory_tag_show(void);
+#endif /*YAYA_MEMORY_TAG_USE*/
 
 bool     memory_zero(void *ptr);
 size_t   memory_size(void *ptr);
@@ -87,8 +527,54 @@ typedef int  (*mem_rand_fn_t)(void);
 typedef void (*mem_seed_fn_t)(unsigned int);
 
 bool memory_swap(void *x, void *y, size_t size);
+/*Равномерное перемешивание Фишера-Йетса. При get_rand NULL генератор у каждого вызова свой и
+  перестановка задается только seed, иначе get_rand как rand со значениями от 0 до RAND_MAX,
+  засеянный set_seed(seed), при set_seed NULL - srand(seed)*/
 bool memory_shuf(void *base, size_t count, size_t size, unsigned int seed, mem_seed_fn_t set_seed, mem_rand_fn_t get_rand);
 bool memory_sort(void *base, size_t count, size_t size, mem_compare_fn_t compare);
+/*Сортировка по возрастанию встроенных типов без функции сравнения, порядок NaN не определен*/
+bool memory_sort_i8(void *base, size_t count);
+bool memory_sort_u8(void *base, size_t count);
+bool memory_sort_i16(void *base, size_t count);
+bool memory_sort_u16(void *base, size_t count);
+bool memory_sort_i32(void *base, size_t count);
+bool memory_sort_u32(void *base, size_t count);
+bool memory_sort_i64(void *base, size_t count);
+bool memory_sort_u64(void *base, size_t count);
+bool memory_sort_f32(void *base, size_t count);
+bool memory_sort_f64(void *base, size_t count);
+
+/*Вид ключа поразрядной сортировки*/
+typedef enum mem_key_t {
+    MEMORY_KEY_UINT,  //беззнаковое целое
+    MEMORY_KEY_INT,   //знаковое целое
+    MEMORY_KEY_FLOAT, //float или double, отрицательный NaN в начале, положительный в конце
+}mem_key_t;
+
+/*Ключ записи как беззнаковое число с нужным порядком, младшие key_width байт*/
+typedef uint64_t (*mem_key_fn_t)(const void *);
+
+/*Устойчивая поразрядная сортировка по ключу шириной key_width байт со смещением key_offset,
+  при key_fn ключ берется из нее. Буфер на count записей выделяется через memory_new*/
+#if YAYA_MEMORY_STATS_USE
+bool memory_sort_radix(mem_stats_t *mem_stats, void *base, size_t count, size_t size, size_t key_offset, size_t key_width, mem_key_t key_kind, mem_key_fn_t key_fn);
+#else
+bool memory_sort_radix(void *base, size_t count, size_t size, size_t key_offset, size_t key_width, mem_key_t key_kind, mem_key_fn_t key_fn);
+#endif /*YAYA_MEMORY_STATS_USE*/
+#if YAYA_MEMORY_PARALLEL_USE
+/*Части массива сортируются в nthreads потоках и сливаются парами всеми потоками, 0 - по числу процессоров.
+  Меньше YAYA_MEMORY_PARALLEL_SORT элементов через memory_sort. Буфер на count элементов через malloc,
+  без зануления и стирания и без учета в mem_stats.
+  Рабочие потоки берутся из пула процесса и создаются один раз. Вместо очередей с кражей работы задачи
+  раздаются общим счетчиком: куски слияния мелкие и свободный поток берет следующий.
+  Пул занят другим вызовом - сортировка идет в вызывающем потоке*/
+bool memory_sort_parallel(void *base, size_t count, size_t size, mem_compare_fn_t compare, size_t nthreads);
+/*Перемешивание разбросом по случайным корзинам в nthreads потоках, 0 - по числу процессоров.
+  Перестановка задается seed, count и числом потоков, меньше YAYA_MEMORY_PARALLEL_SHUF через memory_shuf.
+  Раскладка, перемешивание корзин и возврат идут во всех потоках, последовательного шага нет.
+  Буфер на count элементов через malloc, без буфера перемешивание в одном потоке*/
+bool memory_shuf_parallel(void *base, size_t count, size_t size, unsigned int seed, size_t nthreads);
+#endif /*YAYA_MEMORY_PARALLEL_USE*/
 bool memory_bsearch(void **search_res, void *key, void *base, size_t count, size_t size, mem_compare_fn_t compare);
 bool memory_rsearch(void **search_res, void *key, void *base, size_t count, size_t size, mem_compare_fn_t compare);
 bool memory_dump(void *ptr, size_t len, uintmax_t catbyte, uintmax_t column_mod2);
@@ -97,20 +583,76 @@ bool memory_look(void *ptr, size_t struct_count, size_t struct_size, intmax_t li
 #define mem_list(...)                     ({ (intmax_t[]){__VA_ARGS__, 0}; })
 
 #if YAYA_MEMORY_MACRO_DEF
+#if YAYA_MEMORY_SITE_USE
+/*Место вызова заводится один раз на каждую строку с mem_new*/
+#define MEMORY_SITE_HERE                  ({ static mem_site_t memory_site_ = {__FILE__, __func__, __LINE__, 0, 0, 0, 0}; &memory_site_; })
+#endif /*YAYA_MEMORY_SITE_USE*/
+
 #if YAYA_MEMORY_STATS_USE
+#if YAYA_MEMORY_SITE_USE
+#define mem_new(I, N, O, C, S)            memory_new_site((I), MEMORY_SITE_HERE, (void**)(N), (void*)(O), (size_t)(C), (size_t)(S))
+#else
 #define mem_new(I, N, O, C, S)            memory_new((I), (void**)(N), (void*)(O), (size_t)(C), (size_t)(S))
+#endif /*YAYA_MEMORY_SITE_USE*/
 #define mem_del(I, N)                     memory_del((I), (void**)(N))
+#define mem_reserve(I, N, C, S)           memory_reserve((I), (void**)(N), (size_t)(C), (size_t)(S))
+#define mem_new_batch(I, P, C, S)         memory_new_batch((I), (void**)(P), (size_t)(C), (size_t)(S))
+#define mem_del_batch(I, P, C)            memory_del_batch((I), (void**)(P), (size_t)(C))
+#else
+#if YAYA_MEMORY_SITE_USE
+#define mem_new(N, O, C, S)               memory_new_site(MEMORY_SITE_HERE, (void**)(N), (void*)(O), (size_t)(C), (size_t)(S))
 #else
 #define mem_new(N, O, C, S)               memory_new((void**)(N), (void*)(O), (size_t)(C), (size_t)(S))
+#endif /*YAYA_MEMORY_SITE_USE*/
 #define mem_del(N)                        memory_del((void**)(N))
+#define mem_reserve(N, C, S)              memory_reserve((void**)(N), (size_t)(C), (size_t)(S))
+#define mem_new_batch(P, C, S)            memory_new_batch((void**)(P), (size_t)(C), (size_t)(S))
+#define mem_del_batch(P, C)               memory_del_batch((void**)(P), (size_t)(C))
 #endif /*YAYA_MEMORY_STATS_USE*/
 
+#if YAYA_MEMORY_ALIGN_USE
+#if YAYA_MEMORY_STATS_USE
+#define mem_new_aligned(I, N, C, S, A)    memory_new_aligned((I), (void**)(N), (size_t)(C), (size_t)(S), (size_t)(A))
+#else
+#define mem_new_aligned(N, C, S, A)       memory_new_aligned((void**)(N), (size_t)(C), (size_t)(S), (size_t)(A))
+#endif /*YAYA_MEMORY_STATS_USE*/
+#endif /*YAYA_MEMORY_ALIGN_USE*/
+
+#if YAYA_MEMORY_ARENA_USE
+#if YAYA_MEMORY_STATS_USE
+#define mem_arena_new(I, A, N, O, C, S)   memory_arena_new((I), (A), (void**)(N), (void*)(O), (size_t)(C), (size_t)(S))
+#define mem_arena_reset(I, A)             memory_arena_reset((I), (A))
+#else
+#define mem_arena_new(A, N, O, C, S)      memory_arena_new((A), (void**)(N), (void*)(O), (size_t)(C), (size_t)(S))
+#define mem_arena_reset(A)                memory_arena_reset((A))
+#endif /*YAYA_MEMORY_STATS_USE*/
+#endif /*YAYA_MEMORY_ARENA_USE*/
+
 #define mem_zero(P)                       memory_zero((void*)(P))
 #define mem_size(P)                       memory_size((void*)(P))
 #define mem_step(P, p, S)                 memory_step((void*)(P), (void*)(p), (size_t)(S))
 #define mem_swap(x, y, S)                 memory_swap((void*)(x), (void*)(y), (size_t)(S))
 #define mem_shuf(P, C, S, seed)           memory_shuf((void*)(P), (size_t)(C), (size_t)(S), (seed), (NULL), (NULL))
 #define mem_sort(P, C, S, Fcomp)          memory_sort((void*)(P), (size_t)(C), (size_t)(S), (mem_compare_fn_t)(Fcomp))
+#define mem_sort_i8(P, C)                 memory_sort_i8((void*)(P), (size_t)(C))
+#define mem_sort_u8(P, C)                 memory_sort_u8((void*)(P), (size_t)(C))
+#define mem_sort_i16(P, C)                memory_sort_i16((void*)(P), (size_t)(C))
+#define mem_sort_u16(P, C)                memory_sort_u16((void*)(P), (size_t)(C))
+#define mem_sort_i32(P, C)                memory_sort_i32((void*)(P), (size_t)(C))
+#define mem_sort_u32(P, C)                memory_sort_u32((void*)(P), (size_t)(C))
+#define mem_sort_i64(P, C)                memory_sort_i64((void*)(P), (size_t)(C))
+#define mem_sort_u64(P, C)                memory_sort_u64((void*)(P), (size_t)(C))
+#define mem_sort_f32(P, C)                memory_sort_f32((void*)(P), (size_t)(C))
+#define mem_sort_f64(P, C)                memory_sort_f64((void*)(P), (size_t)(C))
+#if YAYA_MEMORY_STATS_USE
+#define mem_sort_radix(I, P, C, S, O, W, K) memory_sort_radix((I), (void*)(P), (size_t)(C), (size_t)(S), (size_t)(O), (size_t)(W), (K), NULL)
+#else
+#define mem_sort_radix(P, C, S, O, W, K)  memory_sort_radix((void*)(P), (size_t)(C), (size_t)(S), (size_t)(O), (size_t)(W), (K), NULL)
+#endif /*YAYA_MEMORY_STATS_USE*/
+#if YAYA_MEMORY_PARALLEL_USE
+#define mem_sort_parallel(P, C, S, Fcomp, T) memory_sort_parallel((void*)(P), (size_t)(C), (size_t)(S), (mem_compare_fn_t)(Fcomp), (size_t)(T))
+#define mem_shuf_parallel(P, C, S, seed, T) memory_shuf_parallel((void*)(P), (size_t)(C), (size_t)(S), (seed), (size_t)(T))
+#endif /*YAYA_MEMORY_PARALLEL_USE*/
 #define mem_bsearch(R, K, P, C, S, Fcomp) memory_bsearch((void**)(R), (void*)(K), (void*)(P), (size_t)(C), (size_t)(S), (mem_compare_fn_t)(Fcomp))
 #define mem_rsearch(R, K, P, C, S, Fcomp) memory_rsearch((void**)(R), (void*)(K), (void*)(P), (size_t)(C), (size_t)(S), (mem_compare_fn_t)(Fcomp))
 #define mem_dump(P)                       memory_dump((void*)(P), 0, 1, 16)
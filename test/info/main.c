@@ -0,0 +1,160 @@
+//Author                 : Seityagiya Terlekchi
+//Contacts               : seityaya@ukr.net
+//Creation Date          : 2022.12
+//License Link           : https://spdx.org/licenses/LGPL-2.1-or-later.html
+//SPDX-License-Identifier: LGPL-2.1-or-later
+//Copyright © 2022-2023 Seityagiya Terlekchi. All rights reserved.
+
+#include "stdio.h"
+#include "stddef.h"
+#include "stdlib.h"
+#include "string.h"
+
+#include "yaya_memory.h"
+
+/*Проверка, что первые len байт равны value*/
+static bool test_info_same(const uint8_t *ptr, size_t len, uint8_t value){
+    for(size_t i = 0; i < len; i++){
+        if(ptr[i] != value){
+            return false;
+        }
+    }
+    return true;
+}
+
+void test_info_size() {
+    printf("test_info_size\n");
+
+    mem_stats_t *mem_stats = NULL;
+    if(!memory_stats_init(&mem_stats)){
+        printf("ER\n");
+        return;
+    }
+
+    uint8_t *ptr = NULL;
+    if(mem_new(mem_stats, &ptr, NULL, 100, 1) && mem_size(ptr) == 100){
+        printf("00 OK\n");
+    }else{
+        printf("ER\n");
+    }
+
+    /*Выдано не меньше запрошенного, заголовок на каждый живой блок*/
+    mem_stats_t snapshot = {0};
+    memory_stats_snapshot(mem_stats, &snapshot);
+    if(snapshot.memory_request == 100 && snapshot.memory_produce >= 100 && snapshot.memory_header == sizeof(mem_info_t)){
+        printf("01 OK\n");
+    }else{
+        printf("ER\n");
+    }
+
+    memset(ptr, 0x5a, 100);
+    if(mem_zero(ptr) && test_info_same(ptr, 100, 0x00)){
+        printf("02 OK\n");
+    }else{
+        printf("ER\n");
+    }
+
+    /*Чужой и пустой указатель не дают размер*/
+    if(mem_size(NULL) == 0 && !mem_zero(NULL)){
+        printf("03 OK\n");
+    }else{
+        printf("ER\n");
+    }
+
+    if(mem_del(mem_stats, &ptr) && ptr == NULL){
+        printf("04 OK\n");
+    }else{
+        printf("ER\n");
+    }
+
+    memory_stats_snapshot(mem_stats, &snapshot);
+    if(snapshot.memory_header == 0 && snapshot.memory_produce == snapshot.memory_release){
+        printf("05 OK\n");
+    }else{
+        printf("ER\n");
+    }
+
+    memory_stats_free(&mem_stats);
+}
+
+void test_info_resize() {
+    printf("test_info_resize\n");
+
+    mem_stats_t *mem_stats = NULL;
+    if(!memory_stats_init(&mem_stats)){
+        printf("ER\n");
+        return;
+    }
+
+    uint8_t *ptr = NULL;
+    if(!mem_new(mem_stats, &ptr, NULL, 16, 1)){
+        printf("ER\n");
+        return;
+    }
+    memset(ptr, 0xa5, 16);
+
+    /*Рост с переносом: содержимое сохраняется, хвост нулевой*/
+    if(mem_new(mem_stats, &ptr, ptr, 4096, 1) && mem_size(ptr) == 4096 && test_info_same(ptr, 16, 0xa5) && test_info_same(ptr + 16, 4096 - 16, 0x00)){
+        printf("00 OK\n");
+    }else{
+        printf("ER\n");
+    }
+
+    /*Сжатие сохраняет начало*/
+    if(mem_new(mem_stats, &ptr, ptr, 8, 1) && mem_size(ptr) == 8 && test_info_same(ptr, 8, 0xa5)){
+        printf("01 OK\n");
+    }else{
+        printf("ER\n");
+    }
+
+    mem_stats_t snapshot = {0};
+    memory_stats_snapshot(mem_stats, &snapshot);
+    if(snapshot.memory_header == sizeof(mem_info_t)){
+        printf("02 OK\n");
+    }else{
+        printf("ER\n");
+    }
+
+    /*Много блоков: у каждого свой размер и свое содержимое*/
+    enum { COUNT = 1000 };
+    uint8_t *list[COUNT] = {0};
+    bool ok = true;
+    for(size_t i = 0; i < COUNT; i++){
+        ok &= mem_new(mem_stats, &list[i], NULL, i + 1, 1);
+        memset(list[i], (int)(i & 0xff), i + 1);
+    }
+    for(size_t i = 0; i < COUNT; i++){
+        ok &= mem_new(mem_stats, &list[i], list[i], 2 * (i + 1), 1);
+        ok &= mem_size(list[i]) == 2 * (i + 1);
+        ok &= test_info_same(list[i], i + 1, (uint8_t)(i & 0xff));
+        ok &= test_info_same(list[i] + i + 1, i + 1, 0x00);
+    }
+    memory_stats_snapshot(mem_stats, &snapshot);
+    if(ok && snapshot.memory_header == (COUNT + 1) * sizeof(mem_info_t)){
+        printf("03 OK\n");
+    }else{
+        printf("ER\n");
+    }
+
+    for(size_t i = 0; i < COUNT; i++){
+        ok &= mem_del(mem_stats, &list[i]);
+    }
+    ok &= mem_del(mem_stats, &ptr);
+    memory_stats_snapshot(mem_stats, &snapshot);
+    if(ok && snapshot.memory_header == 0 && snapshot.memory_produce == snapshot.memory_release){
+        printf("04 OK\n");
+    }else{
+        printf("ER\n");
+    }
+
+    memory_stats_free(&mem_stats);
+}
+
+int main() {
+    printf("YAYA_MEMORY_INFO_MODE %d, sizeof(mem_info_t) %zu\n", YAYA_MEMORY_INFO_MODE, sizeof(mem_info_t));
+
+    test_info_size();
+    test_info_resize();
+
+    return 0;
+}
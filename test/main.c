@@ -8,9 +8,11 @@
 #include "stdio.h"
 #include "inttypes.h"
 #include "malloc.h"
+#include "pthread.h"
 #include "stddef.h"
 #include "stdlib.h"
 #include "string.h"
+#include "time.h"
 
 #include "yaya_memory.h"
 
@@ -27,7 +29,7 @@ bool memory_fill(void *ptr){
     /*Помещаем указатель со смещением*/
     mem = ptr - offsetof(mem_info_t, memory_ptr);
 
-    size_t produce = malloc_usable_size(mem);
+    size_t produce = mem->memory_produce;
 
     /*Заполнение памяти*/
     memset(mem->memory_ptr, 0x11, produce - offsetof(mem_info_t, memory_ptr));
@@ -777,15 +779,16 @@ void test_search() {
     }
 
 #if YAYA_MEMORY_MACRO_DEF
-    mem_shuf(mas, count_mas, sizeof(int8_t), 1);
+    mem_shuf(mas, count_mas, sizeof(int8_t), 16);
 #else
-    memory_shuf(mas, (size_t)(count_mas), sizeof(int8_t), 1, NULL, NULL);
+    memory_shuf(mas, (size_t)(count_mas), sizeof(int8_t), 16, NULL, NULL);
 #endif
 
     for(int8_t i = 0; i < count_mas; i++){
         printf("%" PRIi8 " ", mas[i]);
     }
     printf("\n");
+    /*При seed 16 значение 9 на месте, которое двоичный поиск проверяет в неотсортированном*/
     int8_t position = 8;
 
 #if YAYA_MEMORY_MACRO_DEF
@@ -870,6 +873,1935 @@ void test_search() {
     fflush(stdout);
 }
 
+void test_slab() {
+    printf("test_slab\n");
+
+#if YAYA_MEMORY_STATS_USE
+    mem_stats_t* mem_stats = NULL;
+    if(!memory_stats_init(&mem_stats)){
+        return;
+    }
+#endif
+
+    const size_t count_ptr = 64;
+    uint8_t *ptr[64] = {0};
+    bool ok = true;
+
+    for(size_t i = 0; i < count_ptr; i++){
+#if YAYA_MEMORY_STATS_USE
+        ok &= memory_new(mem_stats, (void**)(&ptr[i]), NULL, i * 5 + 1, sizeof(uint8_t));
+#else
+        ok &= memory_new((void**)(&ptr[i]), NULL, i * 5 + 1, sizeof(uint8_t));
+#endif
+        memset(ptr[i], (int)(i), i * 5 + 1);
+    }
+
+    if(ok){
+        printf("01 OK\n");
+    }else{
+        printf("ER\n");
+    }
+
+    ok = true;
+    for(size_t i = 0; i < count_ptr; i++){
+        ok &= (memory_size(ptr[i]) == i * 5 + 1);
+        ok &= (ptr[i][0] == (uint8_t)(i)) && (ptr[i][i * 5] == (uint8_t)(i));
+        ok &= ((uintptr_t)(ptr[i]) % alignof(max_align_t) == 0);
+    }
+
+    if(ok){
+        printf("02 OK\n");
+    }else{
+        printf("ER\n");
+    }
+
+    /*Рост через границу класса с сохранением данных*/
+    ok = true;
+    for(size_t i = 0; i < count_ptr; i++){
+#if YAYA_MEMORY_STATS_USE
+        ok &= memory_new(mem_stats, (void**)(&ptr[i]), ptr[i], i * 5 + 40, sizeof(uint8_t));
+#else
+        ok &= memory_new((void**)(&ptr[i]), ptr[i], i * 5 + 40, sizeof(uint8_t));
+#endif
+        ok &= (ptr[i][i * 5] == (uint8_t)(i)) && (ptr[i][i * 5 + 1] == 0) && (ptr[i][i * 5 + 39] == 0);
+    }
+
+    if(ok){
+        printf("03 OK\n");
+    }else{
+        printf("ER\n");
+    }
+
+    ok = true;
+    for(size_t i = 0; i < count_ptr; i++){
+        ok &= memory_zero(ptr[i]);
+        for(size_t j = 0; j < memory_size(ptr[i]); j++){
+            ok &= (ptr[i][j] == 0);
+        }
+#if YAYA_MEMORY_STATS_USE
+        ok &= memory_del(mem_stats, (void**)(&ptr[i]));
+#else
+        ok &= memory_del((void**)(&ptr[i]));
+#endif
+    }
+
+    if(ok){
+        printf("04 OK\n");
+    }else{
+        printf("ER\n");
+    }
+
+#if YAYA_MEMORY_STATS_USE
+    mem_stats_t snapshot = {0};
+    memory_stats_snapshot(mem_stats, &snapshot);
+    if(snapshot.memory_call_new == count_ptr && snapshot.memory_call_res == count_ptr && snapshot.memory_call_del == count_ptr
+       && snapshot.memory_produce == snapshot.memory_release){
+        printf("05 OK\n");
+    }else{
+        printf("ER\n");
+    }
+
+    memory_stats_free(&mem_stats);
+#endif
+
+    printf("\n");
+    fflush(stdout);
+}
+
+void test_arena() {
+    printf("test_arena\n");
+
+#if YAYA_MEMORY_ARENA_USE
+#if YAYA_MEMORY_STATS_USE
+    mem_stats_t* mem_stats = NULL;
+    if(!memory_stats_init(&mem_stats)){
+        return;
+    }
+#endif
+
+    mem_arena_t *arena = NULL;
+    if(memory_arena_init(&arena, 1024)){
+        printf("01 OK\n");
+    }else{
+        printf("ER\n");
+    }
+
+    const size_t count_ptr = 100;
+    uint8_t *ptr[100] = {0};
+    bool ok = true;
+
+    for(size_t r = 0; r < 2; r++){
+        for(size_t i = 0; i < count_ptr; i++){
+#if YAYA_MEMORY_STATS_USE
+            ok &= memory_arena_new(mem_stats, arena, (void**)(&ptr[i]), NULL, i + 1, sizeof(uint8_t));
+#else
+            ok &= memory_arena_new(arena, (void**)(&ptr[i]), NULL, i + 1, sizeof(uint8_t));
+#endif
+            ok &= (memory_size(ptr[i]) == i + 1) && (ptr[i][i] == 0);
+            memset(ptr[i], 0x11, i + 1);
+        }
+
+        /*Рост последнего блока на месте и перенос остальных*/
+        uint8_t *last = ptr[count_ptr - 1];
+#if YAYA_MEMORY_STATS_USE
+        ok &= memory_arena_new(mem_stats, arena, (void**)(&ptr[count_ptr - 1]), ptr[count_ptr - 1], 200, sizeof(uint8_t));
+        ok &= memory_arena_new(mem_stats, arena, (void**)(&ptr[0]), ptr[0], 2000, sizeof(uint8_t));
+#else
+        ok &= memory_arena_new(arena, (void**)(&ptr[count_ptr - 1]), ptr[count_ptr - 1], 200, sizeof(uint8_t));
+        ok &= memory_arena_new(arena, (void**)(&ptr[0]), ptr[0], 2000, sizeof(uint8_t));
+#endif
+        ok &= (last == ptr[count_ptr - 1]) && (ptr[count_ptr - 1][99] == 0x11) && (ptr[count_ptr - 1][100] == 0);
+        ok &= (ptr[0][0] == 0x11) && (ptr[0][1] == 0) && (memory_size(ptr[0]) == 2000);
+        ok &= memory_zero(ptr[50]) && (ptr[50][50] == 0);
+
+#if YAYA_MEMORY_STATS_USE
+        ok &= !memory_del(mem_stats, (void**)(&ptr[1])) && (ptr[1] != NULL);
+        ok &= !memory_new(mem_stats, (void**)(&ptr[1]), ptr[1], 10, sizeof(uint8_t));
+        ok &= memory_arena_reset(mem_stats, arena);
+#else
+        ok &= !memory_del((void**)(&ptr[1])) && (ptr[1] != NULL);
+        ok &= !memory_new((void**)(&ptr[1]), ptr[1], 10, sizeof(uint8_t));
+        ok &= memory_arena_reset(arena);
+#endif
+    }
+
+    if(ok){
+        printf("02 OK\n");
+    }else{
+        printf("ER\n");
+    }
+
+#if YAYA_MEMORY_STATS_USE
+    if(memory_arena_free(mem_stats, &arena) && arena == NULL){
+        printf("03 OK\n");
+    }else{
+        printf("ER\n");
+    }
+
+    mem_stats_t snapshot = {0};
+    memory_stats_snapshot(mem_stats, &snapshot);
+    if(snapshot.memory_call_new == 2 * count_ptr && snapshot.memory_call_res == 4 && snapshot.memory_call_del == snapshot.memory_call_new
+       && snapshot.memory_produce == snapshot.memory_release && snapshot.memory_header == 0){
+        printf("04 OK\n");
+    }else{
+        printf("ER\n");
+    }
+
+    memory_stats_free(&mem_stats);
+#else
+    if(memory_arena_free(&arena) && arena == NULL){
+        printf("03 OK\n");
+    }else{
+        printf("ER\n");
+    }
+#endif
+#endif
+
+    printf("\n");
+    fflush(stdout);
+}
+
+void test_mmap() {
+    printf("test_mmap\n");
+
+#if YAYA_MEMORY_STATS_USE
+    mem_stats_t* mem_stats = NULL;
+    if(!memory_stats_init(&mem_stats)){
+        return;
+    }
+#endif
+
+    const size_t mb = 1024 * 1024;
+    uint8_t *ptr = NULL;
+    bool ok = true;
+
+#if YAYA_MEMORY_STATS_USE
+    ok &= memory_new(mem_stats, (void**)(&ptr), NULL, 4 * mb + 3, sizeof(uint8_t));
+#else
+    ok &= memory_new((void**)(&ptr), NULL, 4 * mb + 3, sizeof(uint8_t));
+#endif
+    ok &= (memory_size(ptr) == 4 * mb + 3) && (ptr[0] == 0) && (ptr[4 * mb + 2] == 0);
+    ok &= ((uintptr_t)(ptr) % alignof(max_align_t) == 0);
+
+    if(ok){
+        printf("01 OK\n");
+    }else{
+        printf("ER\n");
+    }
+
+    memset(ptr, 0x11, memory_size(ptr));
+
+    /*Рост и сжатие с сохранением данных и занулением нового*/
+#if YAYA_MEMORY_STATS_USE
+    ok &= memory_new(mem_stats, (void**)(&ptr), ptr, 32 * mb, sizeof(uint8_t));
+#else
+    ok &= memory_new((void**)(&ptr), ptr, 32 * mb, sizeof(uint8_t));
+#endif
+    ok &= (ptr[0] == 0x11) && (ptr[4 * mb + 2] == 0x11) && (ptr[4 * mb + 3] == 0) && (ptr[32 * mb - 1] == 0);
+
+    if(ok){
+        printf("02 OK\n");
+    }else{
+        printf("ER\n");
+    }
+
+#if YAYA_MEMORY_STATS_USE
+    ok &= memory_new(mem_stats, (void**)(&ptr), ptr, 2 * mb, sizeof(uint8_t));
+    ok &= memory_new(mem_stats, (void**)(&ptr), ptr, 3 * mb, sizeof(uint8_t));
+#else
+    ok &= memory_new((void**)(&ptr), ptr, 2 * mb, sizeof(uint8_t));
+    ok &= memory_new((void**)(&ptr), ptr, 3 * mb, sizeof(uint8_t));
+#endif
+    ok &= (ptr[2 * mb - 1] == 0x11) && (ptr[2 * mb] == 0) && (ptr[3 * mb - 1] == 0);
+    ok &= memory_zero(ptr) && (ptr[0] == 0);
+
+#if YAYA_MEMORY_STATS_USE
+    ok &= memory_del(mem_stats, (void**)(&ptr));
+#else
+    ok &= memory_del((void**)(&ptr));
+#endif
+
+    if(ok && ptr == NULL){
+        printf("03 OK\n");
+    }else{
+        printf("ER\n");
+    }
+
+#if YAYA_MEMORY_STATS_USE
+    mem_stats_t snapshot = {0};
+    memory_stats_snapshot(mem_stats, &snapshot);
+    if(snapshot.memory_produce == snapshot.memory_release && snapshot.memory_call_res == 3){
+        printf("04 OK\n");
+    }else{
+        printf("ER\n");
+    }
+    memory_stats_free(&mem_stats);
+#endif
+
+    printf("\n");
+    fflush(stdout);
+}
+
+void test_huge() {
+    printf("test_huge\n");
+
+#if YAYA_MEMORY_HUGE_USE
+#if YAYA_MEMORY_STATS_USE
+    mem_stats_t* mem_stats = NULL;
+    if(!memory_stats_init(&mem_stats)){
+        return;
+    }
+#endif
+
+    const size_t mb = 1024 * 1024;
+    uint8_t *ptr = NULL;
+    bool ok = true;
+
+#if YAYA_MEMORY_STATS_USE
+    ok &= memory_new(mem_stats, (void**)(&ptr), NULL, 5 * mb, sizeof(uint8_t));
+#else
+    ok &= memory_new((void**)(&ptr), NULL, 5 * mb, sizeof(uint8_t));
+#endif
+    /*Блок вместе с заголовком начинается на границе большой страницы*/
+    mem_info_t *mem = (mem_info_t*)(ptr - offsetof(mem_info_t, memory_ptr));
+    ok &= ((uintptr_t)(mem) % YAYA_MEMORY_HUGE_PAGE == 0) && (mem->memory_produce % YAYA_MEMORY_HUGE_PAGE == 0);
+    ok &= (memory_size(ptr) == 5 * mb) && (ptr[0] == 0) && (ptr[5 * mb - 1] == 0);
+
+    if(ok){
+        printf("01 OK\n");
+    }else{
+        printf("ER\n");
+    }
+
+    memset(ptr, 0x11, memory_size(ptr));
+
+#if YAYA_MEMORY_STATS_USE
+    ok &= memory_new(mem_stats, (void**)(&ptr), ptr, 9 * mb, sizeof(uint8_t));
+#else
+    ok &= memory_new((void**)(&ptr), ptr, 9 * mb, sizeof(uint8_t));
+#endif
+    ok &= (ptr[5 * mb - 1] == 0x11) && (ptr[5 * mb] == 0) && (ptr[9 * mb - 1] == 0);
+    mem = (mem_info_t*)(ptr - offsetof(mem_info_t, memory_ptr));
+    ok &= ((uintptr_t)(mem) % YAYA_MEMORY_HUGE_PAGE == 0);
+
+    if(ok){
+        printf("02 OK\n");
+    }else{
+        printf("ER\n");
+    }
+
+#if YAYA_MEMORY_STATS_USE
+    mem_stats_t snapshot = {0};
+    memory_stats_snapshot(mem_stats, &snapshot);
+    mem = (mem_info_t*)(ptr - offsetof(mem_info_t, memory_ptr));
+    ok &= (snapshot.memory_huge == mem->memory_produce);
+    ok &= memory_del(mem_stats, (void**)(&ptr));
+    memory_stats_snapshot(mem_stats, &snapshot);
+    ok &= (snapshot.memory_huge == 0);
+    memory_stats_free(&mem_stats);
+#else
+    ok &= memory_del((void**)(&ptr));
+#endif
+
+    if(ok && ptr == NULL){
+        printf("03 OK\n");
+    }else{
+        printf("ER\n");
+    }
+#endif
+
+    printf("\n");
+    fflush(stdout);
+}
+
+void test_reserve() {
+    printf("test_reserve\n");
+
+    const size_t count_mas = 100000;
+    uint32_t *mas = NULL;
+    size_t count_move = 0;
+    bool ok = true;
+
+    /*Добавление по одному элементу*/
+    for(size_t i = 0; i < count_mas; i++){
+        uint32_t *old = mas;
+#if YAYA_MEMORY_MACRO_DEF
+#if YAYA_MEMORY_STATS_USE
+        ok &= mem_new(NULL, &mas, mas, i + 1, sizeof(uint32_t));
+#else
+        ok &= mem_new(&mas, mas, i + 1, sizeof(uint32_t));
+#endif
+#endif
+        ok &= (mas[i] == 0);
+        mas[i] = (uint32_t)(i);
+        if(old != mas){
+            count_move++;
+        }
+    }
+
+    for(size_t i = 0; i < count_mas; i++){
+        ok &= (mas[i] == i);
+    }
+
+    if(ok && count_move < 64){
+        printf("01 OK\n");
+    }else{
+        printf("ER\n");
+    }
+
+    /*Хвост после запрошенного заполнен YAYA_MEMORY_VALUE_AFTER_MEM*/
+    mem_info_t *mem = (mem_info_t*)((uint8_t*)(mas) - offsetof(mem_info_t, memory_ptr));
+    for(size_t i = mem->memory_request; i < mem->memory_produce - offsetof(mem_info_t, memory_ptr); i++){
+        ok &= (mem->memory_ptr[i] == YAYA_MEMORY_VALUE_AFTER_MEM);
+    }
+
+    if(ok){
+        printf("02 OK\n");
+    }else{
+        printf("ER\n");
+    }
+
+    /*После резерва рост не двигает память*/
+#if YAYA_MEMORY_MACRO_DEF
+#if YAYA_MEMORY_STATS_USE
+    ok &= mem_reserve(NULL, &mas, 2 * count_mas, sizeof(uint32_t));
+#else
+    ok &= mem_reserve(&mas, 2 * count_mas, sizeof(uint32_t));
+#endif
+#endif
+    uint32_t *old = mas;
+    ok &= (memory_size(mas) == count_mas * sizeof(uint32_t));
+    for(size_t i = count_mas; i < 2 * count_mas; i++){
+#if YAYA_MEMORY_MACRO_DEF
+#if YAYA_MEMORY_STATS_USE
+        ok &= mem_new(NULL, &mas, mas, i + 1, sizeof(uint32_t));
+#else
+        ok &= mem_new(&mas, mas, i + 1, sizeof(uint32_t));
+#endif
+#endif
+        mas[i] = (uint32_t)(i);
+    }
+
+    if(ok && old == mas && mas[count_mas - 1] == count_mas - 1 && mas[2 * count_mas - 1] == 2 * count_mas - 1){
+        printf("03 OK\n");
+    }else{
+        printf("ER\n");
+    }
+
+    /*Тот же размер после резерва не теряет запас*/
+#if YAYA_MEMORY_MACRO_DEF
+#if YAYA_MEMORY_STATS_USE
+    ok &= mem_reserve(NULL, &mas, 3 * count_mas, sizeof(uint32_t));
+#else
+    ok &= mem_reserve(&mas, 3 * count_mas, sizeof(uint32_t));
+#endif
+#endif
+    old = mas;
+    mem = (mem_info_t*)((uint8_t*)(mas) - offsetof(mem_info_t, memory_ptr));
+    size_t produce = mem->memory_produce;
+#if YAYA_MEMORY_MACRO_DEF
+#if YAYA_MEMORY_STATS_USE
+    ok &= mem_new(NULL, &mas, mas, 2 * count_mas, sizeof(uint32_t));
+#else
+    ok &= mem_new(&mas, mas, 2 * count_mas, sizeof(uint32_t));
+#endif
+#endif
+    mem = (mem_info_t*)((uint8_t*)(mas) - offsetof(mem_info_t, memory_ptr));
+
+    if(ok && old == mas && mem->memory_produce == produce && produce >= 3 * count_mas * sizeof(uint32_t)
+       && memory_size(mas) == 2 * count_mas * sizeof(uint32_t) && mas[2 * count_mas - 1] == 2 * count_mas - 1){
+        printf("04 OK\n");
+    }else{
+        printf("ER\n");
+    }
+
+#if YAYA_MEMORY_MACRO_DEF
+#if YAYA_MEMORY_STATS_USE
+    mem_del(NULL, &mas);
+#else
+    mem_del(&mas);
+#endif
+#endif
+
+    printf("\n");
+    fflush(stdout);
+}
+
+void test_aligned() {
+    printf("test_aligned\n");
+
+#if YAYA_MEMORY_ALIGN_USE
+#if YAYA_MEMORY_STATS_USE
+    mem_stats_t* mem_stats = NULL;
+    if(!memory_stats_init(&mem_stats)){
+        return;
+    }
+#endif
+
+    const size_t count_align = 6;
+    const size_t align[6] = {8, 16, 32, 64, 512, 4096};
+    uint8_t *ptr[6] = {0};
+    bool ok = true;
+
+    for(size_t i = 0; i < count_align; i++){
+#if YAYA_MEMORY_STATS_USE
+        ok &= memory_new_aligned(mem_stats, (void**)(&ptr[i]), 100, sizeof(uint8_t), align[i]);
+#else
+        ok &= memory_new_aligned((void**)(&ptr[i]), 100, sizeof(uint8_t), align[i]);
+#endif
+        ok &= ((uintptr_t)(ptr[i]) % align[i] == 0) && (memory_size(ptr[i]) == 100) && (ptr[i][99] == 0);
+        memset(ptr[i], 0x11, 100);
+    }
+
+    if(ok){
+        printf("01 OK\n");
+    }else{
+        printf("ER\n");
+    }
+
+#if YAYA_MEMORY_STATS_USE
+    ok &= !memory_new_aligned(mem_stats, (void**)(&ptr[0]), 100, sizeof(uint8_t), 48);
+#else
+    ok &= !memory_new_aligned((void**)(&ptr[0]), 100, sizeof(uint8_t), 48);
+#endif
+
+    if(ok){
+        printf("02 OK\n");
+    }else{
+        printf("ER\n");
+    }
+
+    /*Перераспределение сохраняет выравнивание*/
+    for(size_t i = 0; i < count_align; i++){
+#if YAYA_MEMORY_STATS_USE
+        ok &= memory_new(mem_stats, (void**)(&ptr[i]), ptr[i], 10000, sizeof(uint8_t));
+#else
+        ok &= memory_new((void**)(&ptr[i]), ptr[i], 10000, sizeof(uint8_t));
+#endif
+        ok &= ((uintptr_t)(ptr[i]) % align[i] == 0) && (ptr[i][99] == 0x11) && (ptr[i][100] == 0) && (ptr[i][9999] == 0);
+        ok &= memory_zero(ptr[i]) && (ptr[i][0] == 0);
+#if YAYA_MEMORY_STATS_USE
+        ok &= memory_del(mem_stats, (void**)(&ptr[i]));
+#else
+        ok &= memory_del((void**)(&ptr[i]));
+#endif
+    }
+
+    if(ok){
+        printf("03 OK\n");
+    }else{
+        printf("ER\n");
+    }
+
+#if YAYA_MEMORY_STATS_USE
+    mem_stats_t snapshot = {0};
+    memory_stats_snapshot(mem_stats, &snapshot);
+    if(snapshot.memory_produce == snapshot.memory_release && snapshot.memory_call_new == count_align){
+        printf("04 OK\n");
+    }else{
+        printf("ER\n");
+    }
+    memory_stats_free(&mem_stats);
+#endif
+#endif
+
+    printf("\n");
+    fflush(stdout);
+}
+
+void test_batch() {
+    printf("test_batch\n");
+
+#if YAYA_MEMORY_STATS_USE
+    mem_stats_t* mem_stats = NULL;
+    if(!memory_stats_init(&mem_stats)){
+        return;
+    }
+#endif
+
+    const size_t count_ptr = 1000;
+    const size_t count_size = 3;
+    const size_t size[3] = {24, 200, 5000};
+    uint8_t *ptr[1000] = {0};
+    bool ok = true;
+
+    for(size_t s = 0; s < count_size; s++){
+#if YAYA_MEMORY_STATS_USE
+        ok &= memory_new_batch(mem_stats, (void**)(ptr), count_ptr, size[s]);
+#else
+        ok &= memory_new_batch((void**)(ptr), count_ptr, size[s]);
+#endif
+        for(size_t i = 0; i < count_ptr; i++){
+            ok &= (ptr[i] != NULL) && (memory_size(ptr[i]) == size[s]) && (ptr[i][size[s] - 1] == 0);
+            memset(ptr[i], 0x11, size[s]);
+        }
+
+        /*Освобождение части поштучно, остальных пачкой*/
+#if YAYA_MEMORY_STATS_USE
+        ok &= memory_del(mem_stats, (void**)(&ptr[0]));
+        ok &= !memory_del_batch(mem_stats, (void**)(ptr), count_ptr);
+#else
+        ok &= memory_del((void**)(&ptr[0]));
+        ok &= !memory_del_batch((void**)(ptr), count_ptr);
+#endif
+        for(size_t i = 0; i < count_ptr; i++){
+            ok &= (ptr[i] == NULL);
+        }
+    }
+
+    if(ok){
+        printf("01 OK\n");
+    }else{
+        printf("ER\n");
+    }
+
+#if YAYA_MEMORY_STATS_USE
+    ok &= !memory_new_batch(mem_stats, (void**)(ptr), 0, 1);
+    ok &= !memory_new_batch(mem_stats, NULL, 1, 1);
+#else
+    ok &= !memory_new_batch((void**)(ptr), 0, 1);
+    ok &= !memory_new_batch(NULL, 1, 1);
+#endif
+
+    if(ok){
+        printf("02 OK\n");
+    }else{
+        printf("ER\n");
+    }
+
+#if YAYA_MEMORY_STATS_USE
+    mem_stats_t snapshot = {0};
+    memory_stats_snapshot(mem_stats, &snapshot);
+    if(snapshot.memory_produce == snapshot.memory_release && snapshot.memory_call_new == count_ptr * count_size
+       && snapshot.memory_call_del == count_ptr * count_size){
+        printf("03 OK\n");
+    }else{
+        printf("ER\n");
+    }
+    memory_stats_free(&mem_stats);
+#endif
+
+    printf("\n");
+    fflush(stdout);
+}
+
+#if YAYA_MEMORY_STATS_USE
+static void *test_stats_thread(void *arg) {
+    mem_stats_t *mem_stats = arg;
+    void *ptr = NULL;
+
+    for(size_t i = 0; i < 10000; i++){
+        memory_new(mem_stats, &ptr, NULL, i % 300 + 1, sizeof(char));
+        memory_new(mem_stats, &ptr, ptr, i % 300 + 2, sizeof(char));
+        memory_del(mem_stats, &ptr);
+    }
+    return NULL;
+}
+
+/*Блоки выделяет один поток, освобождает другой*/
+typedef struct test_stats_pass_t {
+    mem_stats_t *mem_stats;
+    void        *ptr[100];
+    bool         del;
+}test_stats_pass_t;
+
+static void *test_stats_pass(void *arg) {
+    test_stats_pass_t *pass = arg;
+    for(size_t i = 0; i < 100; i++){
+        if(pass->del){
+            memory_del(pass->mem_stats, &pass->ptr[i]);
+        }else{
+            memory_new(pass->mem_stats, &pass->ptr[i], NULL, 1000, sizeof(char));
+        }
+    }
+    return NULL;
+}
+#endif
+
+void test_stats() {
+    printf("test_stats\n");
+
+#if YAYA_MEMORY_STATS_USE
+    mem_stats_t* mem_stats = NULL;
+    if(!memory_stats_init(&mem_stats)){
+        return;
+    }
+
+    const size_t count_thread = 8;
+    pthread_t thread[8];
+
+    for(size_t i = 0; i < count_thread; i++){
+        pthread_create(&thread[i], NULL, test_stats_thread, mem_stats);
+    }
+    for(size_t i = 0; i < count_thread; i++){
+        pthread_join(thread[i], NULL);
+    }
+
+    mem_stats_t snapshot = {0};
+    if(memory_stats_snapshot(mem_stats, &snapshot)){
+        printf("01 OK\n");
+    }else{
+        printf("ER\n");
+    }
+
+    if(snapshot.memory_call_new == count_thread * 10000 && snapshot.memory_call_res == count_thread * 10000
+       && snapshot.memory_call_del == count_thread * 10000 && snapshot.memory_produce == snapshot.memory_release){
+        printf("02 OK\n");
+    }else{
+        printf("ER\n");
+    }
+
+    /*Пик при освобождении чужих блоков не копит все выделенное*/
+    mem_stats_t begin = {0};
+    test_stats_pass_t pass = {.mem_stats = mem_stats};
+    memory_stats_snapshot(mem_stats, &begin);
+    for(size_t round = 0; round < 10; round++){
+        for(size_t step = 0; step < 2; step++){
+            pass.del = (step == 1);
+            pthread_create(&thread[0], NULL, test_stats_pass, &pass);
+            pthread_join(thread[0], NULL);
+        }
+    }
+    memory_stats_snapshot(mem_stats, &snapshot);
+    size_t batch = (snapshot.memory_produce - begin.memory_produce) / 10;
+    if(snapshot.memory_peak - begin.memory_peak <= batch && snapshot.memory_produce == snapshot.memory_release){
+        printf("03 OK\n");
+    }else{
+        printf("ER\n");
+    }
+
+    memory_stats_show(mem_stats);
+    memory_stats_free(&mem_stats);
+
+    /*Статистика не из memory_stats_init считается в поля*/
+    mem_stats_t local = {0};
+    uint8_t *ptr = NULL;
+    bool ok = true;
+    ok &= memory_new(&local, (void**)(&ptr), NULL, 16, sizeof(uint8_t));
+    ok &= memory_new(&local, (void**)(&ptr), ptr, 32, sizeof(uint8_t));
+    ok &= memory_del(&local, (void**)(&ptr));
+    ok &= (local.memory_call_new == 1) && (local.memory_call_res == 1) && (local.memory_call_del == 1);
+    ok &= (local.memory_request == 32) && (local.memory_produce == local.memory_release) && (local.memory_peak > 0);
+    size_t call_new = snapshot.memory_call_new;
+    ok &= memory_new(&snapshot, (void**)(&ptr), NULL, 16, sizeof(uint8_t));
+    ok &= memory_del(&snapshot, (void**)(&ptr));
+    ok &= (snapshot.memory_call_new == call_new + 1);
+
+    if(ok){
+        printf("04 OK\n");
+    }else{
+        printf("ER\n");
+    }
+#endif
+
+    printf("\n");
+    fflush(stdout);
+}
+
+void test_hist() {
+    printf("test_hist\n");
+
+#if YAYA_MEMORY_STATS_USE
+    mem_stats_t* mem_stats = NULL;
+    if(!memory_stats_init(&mem_stats)){
+        return;
+    }
+
+    uint8_t *ptr[3] = {0};
+    bool ok = true;
+
+    /*Корзина i для размеров [2^(i-1), 2^i)*/
+    ok &= memory_new(mem_stats, (void**)(&ptr[0]), NULL, 10, sizeof(uint8_t));
+    ok &= memory_new(mem_stats, (void**)(&ptr[1]), NULL, 100, sizeof(uint8_t));
+    ok &= memory_new(mem_stats, (void**)(&ptr[2]), NULL, 5000, sizeof(uint8_t));
+
+    mem_stats_t snapshot = {0};
+    memory_stats_snapshot(mem_stats, &snapshot);
+    ok &= (snapshot.memory_hist_request[4] == 1) && (snapshot.memory_hist_request[7] == 1) && (snapshot.memory_hist_request[13] == 1);
+    ok &= (snapshot.memory_hist_live[4] == 10) && (snapshot.memory_hist_live[7] == 100) && (snapshot.memory_hist_live[13] == 5000);
+
+    if(ok){
+        printf("01 OK\n");
+    }else{
+        printf("ER\n");
+    }
+
+    /*Рост переносит живые байты в другую корзину, пик не уменьшается*/
+    size_t peak = snapshot.memory_peak;
+    ok &= memory_new(mem_stats, (void**)(&ptr[0]), ptr[0], 20, sizeof(uint8_t));
+    ok &= memory_del(mem_stats, (void**)(&ptr[2]));
+    memory_stats_snapshot(mem_stats, &snapshot);
+    ok &= (snapshot.memory_hist_live[4] == 0) && (snapshot.memory_hist_live[5] == 20) && (snapshot.memory_hist_live[13] == 0);
+    ok &= (snapshot.memory_hist_request[5] == 1) && (snapshot.memory_peak >= peak);
+    ok &= (peak >= snapshot.memory_produce - snapshot.memory_release + 5000);
+
+    if(ok){
+        printf("02 OK\n");
+    }else{
+        printf("ER\n");
+    }
+
+    ok &= memory_del(mem_stats, (void**)(&ptr[0]));
+    ok &= memory_del(mem_stats, (void**)(&ptr[1]));
+    memory_stats_snapshot(mem_stats, &snapshot);
+    for(size_t b = 0; b < YAYA_MEMORY_STATS_BUCKET; b++){
+        ok &= (snapshot.memory_hist_live[b] == 0);
+    }
+
+    if(ok){
+        printf("03 OK\n");
+    }else{
+        printf("ER\n");
+    }
+
+    memory_stats_show(mem_stats);
+    memory_stats_free(&mem_stats);
+#endif
+
+    printf("\n");
+    fflush(stdout);
+}
+
+void test_site() {
+    printf("test_site\n");
+
+#if YAYA_MEMORY_SITE_USE && YAYA_MEMORY_MACRO_DEF && YAYA_MEMORY_STATS_USE
+    uint8_t *ptr[10] = {0};
+    uint8_t *big = NULL;
+    bool ok = true;
+
+    for(size_t i = 0; i < 10; i++){
+        ok &= mem_new(NULL, &ptr[i], NULL, 1000, sizeof(uint8_t));
+    }
+    ok &= mem_new(NULL, &big, NULL, 50000, sizeof(uint8_t));
+
+    /*Места вызова по убыванию живых байт*/
+    mem_site_t site[2] = {0};
+    ok &= (memory_site_top(site, 2) == 2);
+    ok &= (site[0].memory_live == 50000) && (site[0].memory_call == 1);
+    ok &= (site[1].memory_live == 10000) && (site[1].memory_call == 10) && (site[1].memory_line + 2 == site[0].memory_line);
+    ok &= (strcmp(site[0].memory_func, "test_site") == 0);
+
+    if(ok){
+        printf("01 OK\n");
+    }else{
+        printf("ER\n");
+    }
+
+    /*Рост переносит блок на место вызова с ростом*/
+    ok &= mem_new(NULL, &ptr[0], ptr[0], 100000, sizeof(uint8_t));
+    ok &= mem_del(NULL, &big);
+    ok &= (memory_site_top(site, 2) == 2);
+    ok &= (site[0].memory_live == 100000) && (site[1].memory_live == 9000);
+    ok &= (site[0].memory_request == 99000) && (site[1].memory_request == 10000);
+
+    if(ok){
+        printf("02 OK\n");
+    }else{
+        printf("ER\n");
+    }
+
+    ok &= mem_del_batch(NULL, ptr, 10);
+    ok &= (memory_site_top(site, 1) == 1) && (site[0].memory_live == 0);
+
+    if(ok){
+        printf("03 OK\n");
+    }else{
+        printf("ER\n");
+    }
+#endif
+
+    printf("\n");
+    fflush(stdout);
+}
+
+void test_export() {
+    printf("test_export\n");
+
+#if YAYA_MEMORY_STATS_USE
+    mem_stats_t* mem_stats = NULL;
+    if(!memory_stats_init(&mem_stats)){
+        return;
+    }
+
+    uint8_t *ptr = NULL;
+    bool ok = true;
+    ok &= memory_new(mem_stats, (void**)(&ptr), NULL, 100, sizeof(uint8_t));
+
+    /*Длина без буфера, обрезка и полная выгрузка*/
+    char buf[8192] = {0};
+    size_t len = memory_stats_export(mem_stats, MEMORY_FORMAT_JSON, NULL, 0);
+    ok &= (len > 0) && (len < sizeof(buf));
+    ok &= (memory_stats_export(mem_stats, MEMORY_FORMAT_JSON, buf, 8) == len) && (strlen(buf) == 7);
+    ok &= (memory_stats_export(mem_stats, MEMORY_FORMAT_JSON, buf, sizeof(buf)) == len) && (strlen(buf) == len);
+    ok &= (buf[0] == '{') && (strstr(buf, "\"call_new\":1,") != NULL) && (strstr(buf, "\"request\":100,") != NULL);
+
+    if(ok){
+        printf("01 OK\n");
+    }else{
+        printf("ER\n");
+    }
+
+    /*Число столбцов CSV в заголовке и в строке совпадает*/
+    size_t comma_head = 0;
+    size_t comma_row = 0;
+    memory_stats_export(mem_stats, MEMORY_FORMAT_CSV_HEAD, buf, sizeof(buf));
+    for(char *c = buf; *c != '\0'; c++){
+        comma_head += (*c == ',');
+    }
+    memory_stats_export(mem_stats, MEMORY_FORMAT_CSV, buf, sizeof(buf));
+    for(char *c = buf; *c != '\0'; c++){
+        comma_row += (*c == ',');
+    }
+    ok &= (comma_head == comma_row) && (comma_head > 2 * YAYA_MEMORY_STATS_BUCKET);
+
+    memory_stats_export(mem_stats, MEMORY_FORMAT_PROM, buf, sizeof(buf));
+    ok &= (strstr(buf, "# TYPE yaya_memory_call_new_total counter\nyaya_memory_call_new_total 1\n") != NULL);
+    ok &= (strstr(buf, "yaya_memory_hist_live_bytes{bucket=\"127\"} 100\n") != NULL);
+
+    /*Гистограмма запросов накопленная: 100 байт попадают в le="127" и все большие границы*/
+    ok &= (strstr(buf, "# TYPE yaya_memory_request_size_bytes histogram\n") != NULL);
+    ok &= (strstr(buf, "yaya_memory_request_size_bytes_bucket{le=\"63\"} 0\n") != NULL);
+    ok &= (strstr(buf, "yaya_memory_request_size_bytes_bucket{le=\"127\"} 1\n") != NULL);
+    ok &= (strstr(buf, "yaya_memory_request_size_bytes_bucket{le=\"255\"} 1\n") != NULL);
+    ok &= (strstr(buf, "yaya_memory_request_size_bytes_bucket{le=\"+Inf\"} 1\n") != NULL);
+    ok &= (strstr(buf, "yaya_memory_request_size_bytes_sum 100\n") != NULL);
+    ok &= (strstr(buf, "yaya_memory_request_size_bytes_count 1\n") != NULL);
+
+    if(ok){
+        printf("02 OK\n");
+    }else{
+        printf("ER\n");
+    }
+
+    FILE *file = tmpfile();
+    ok &= (file != NULL) && memory_stats_write(mem_stats, MEMORY_FORMAT_PROM, file);
+
+#if YAYA_MEMORY_STATS_REPORT
+    /*Периодический вывод: заголовок CSV и несколько строк*/
+    FILE *report_file = tmpfile();
+    mem_report_t *report = NULL;
+    ok &= memory_stats_report_start(&report, mem_stats, MEMORY_FORMAT_CSV, report_file, 5);
+    struct timespec pause = {0, 40000000L};
+    nanosleep(&pause, NULL);
+    ok &= memory_stats_report_stop(&report) && (report == NULL);
+
+    size_t line = 0;
+    rewind(report_file);
+    for(int c = fgetc(report_file); c != EOF; c = fgetc(report_file)){
+        line += (c == '\n');
+    }
+    ok &= (line >= 3);
+    fclose(report_file);
+#endif
+
+    if(ok){
+        printf("03 OK\n");
+    }else{
+        printf("ER\n");
+    }
+
+    if(file != NULL){
+        fclose(file);
+    }
+    memory_del(mem_stats, (void**)(&ptr));
+    memory_stats_free(&mem_stats);
+#endif
+
+    printf("\n");
+    fflush(stdout);
+}
+
+void test_sample() {
+    printf("test_sample\n");
+
+#if YAYA_MEMORY_SAMPLE_USE && YAYA_MEMORY_MACRO_DEF && YAYA_MEMORY_STATS_USE
+    uint8_t *ptr[8] = {0};
+    bool ok = true;
+
+    /*Шаг в один байт, в выборку попадает каждое выделение*/
+    size_t live = memory_sample_count();
+    ok &= memory_sample_rate(1);
+    for(size_t i = 0; i < 8; i++){
+        ok &= mem_new(NULL, &ptr[i], NULL, 64, sizeof(uint8_t));
+    }
+    ok &= (memory_sample_count() == live + 8);
+
+    if(ok){
+        printf("01 OK\n");
+    }else{
+        printf("ER\n");
+    }
+
+    /*Рост переносит запись, профиль показывает новый размер*/
+    ok &= mem_new(NULL, &ptr[0], ptr[0], 4096, sizeof(uint8_t));
+    ok &= (memory_sample_count() == live + 8);
+
+    char buf[4096] = {0};
+    FILE *file = tmpfile();
+    ok &= (file != NULL) && memory_sample_dump(file);
+    if(file != NULL){
+        rewind(file);
+        size_t len = fread(buf, 1, sizeof(buf) - 1, file);
+        buf[len] = '\0';
+        fclose(file);
+    }
+    ok &= (strncmp(buf, "heap profile: ", 14) == 0) && (strstr(buf, "@ heap_v2/1\n") != NULL);
+    ok &= (strstr(buf, "\n1: 4096 [1: 4096] @ 0x") != NULL);
+
+    if(ok){
+        printf("02 OK\n");
+    }else{
+        printf("ER\n");
+    }
+
+    /*Освобождение снимает блоки с учета, выключенная выборка ничего не пишет*/
+    ok &= mem_del_batch(NULL, ptr, 4);
+    for(size_t i = 4; i < 8; i++){
+        ok &= mem_del(NULL, &ptr[i]);
+    }
+    ok &= (memory_sample_count() == live);
+
+    ok &= memory_sample_rate(0);
+    ok &= mem_new(NULL, &ptr[0], NULL, 64, sizeof(uint8_t));
+    ok &= (memory_sample_count() == live);
+    ok &= mem_del(NULL, &ptr[0]);
+    ok &= memory_sample_rate(YAYA_MEMORY_SAMPLE_RATE);
+
+    if(ok){
+        printf("03 OK\n");
+    }else{
+        printf("ER\n");
+    }
+#endif
+
+    printf("\n");
+    fflush(stdout);
+}
+
+void test_latency() {
+    printf("test_latency\n");
+
+#if YAYA_MEMORY_LATENCY_USE && YAYA_MEMORY_MACRO_DEF && YAYA_MEMORY_STATS_USE
+    uint32_t *ptr = NULL;
+    bool ok = true;
+
+    ok &= memory_latency_reset();
+    for(size_t i = 0; i < 100; i++){
+        ok &= mem_new(NULL, &ptr, NULL, 64, sizeof(uint32_t));
+        ok &= mem_new(NULL, &ptr, ptr, 128, sizeof(uint32_t));
+        ok &= mem_del(NULL, &ptr);
+    }
+
+    /*Число вызовов каждого вида и порядок перцентилей*/
+    mem_latency_t latency = {0};
+    ok &= memory_latency_get(MEMORY_LATENCY_NEW, &latency) && (latency.memory_count == 100);
+    ok &= (latency.memory_p50 <= latency.memory_p99) && (latency.memory_p99 <= latency.memory_p999) && (latency.memory_p999 <= latency.memory_max);
+    ok &= memory_latency_get(MEMORY_LATENCY_RES, &latency) && (latency.memory_count == 100);
+    ok &= memory_latency_get(MEMORY_LATENCY_DEL, &latency) && (latency.memory_count == 100) && (latency.memory_max > 0);
+
+    if(ok){
+        printf("01 OK\n");
+    }else{
+        printf("ER\n");
+    }
+
+    int8_t mas[64] = {0};
+    int8_t key = 7;
+    int8_t *res = NULL;
+    for(size_t i = 0; i < 64; i++){
+        mas[i] = (int8_t)((i * 37) % 64);
+    }
+    ok &= mem_sort(mas, 64, sizeof(int8_t), comp);
+    ok &= mem_bsearch(&res, &key, mas, 64, sizeof(int8_t), comp);
+    ok &= mem_rsearch(&res, &key, mas, 64, sizeof(int8_t), comp);
+    ok &= memory_latency_get(MEMORY_LATENCY_SORT, &latency) && (latency.memory_count == 1);
+    ok &= memory_latency_get(MEMORY_LATENCY_SEARCH, &latency) && (latency.memory_count == 2);
+    ok &= mem_shuf(mas, 64, sizeof(int8_t), 1);
+    ok &= memory_latency_get(MEMORY_LATENCY_SHUF, &latency) && (latency.memory_count == 1);
+
+    /*Пачка считается одним вызовом*/
+    uint32_t *list[16] = {0};
+    ok &= mem_new_batch(NULL, list, 16, sizeof(uint32_t));
+    ok &= mem_del_batch(NULL, list, 16);
+    ok &= memory_latency_get(MEMORY_LATENCY_NEW, &latency) && (latency.memory_count == 101);
+    ok &= memory_latency_get(MEMORY_LATENCY_DEL, &latency) && (latency.memory_count == 101);
+
+    /*Сброс обнуляет счетчики*/
+    ok &= memory_latency_reset();
+    ok &= memory_latency_get(MEMORY_LATENCY_NEW, &latency) && (latency.memory_count == 0) && (latency.memory_max == 0);
+
+    if(ok){
+        printf("02 OK\n");
+    }else{
+        printf("ER\n");
+    }
+#endif
+
+    printf("\n");
+    fflush(stdout);
+}
+
+void test_live() {
+    printf("test_live\n");
+
+#if YAYA_MEMORY_LIVE_USE && YAYA_MEMORY_MACRO_DEF && YAYA_MEMORY_STATS_USE
+    uint8_t *ptr[8] = {0};
+    uint8_t *one = NULL;
+    bool ok = true;
+
+    /*Каждый выделенный блок учтен, перенос при росте не меняет число*/
+    size_t live = memory_live_count();
+    ok &= mem_new(NULL, &one, NULL, 16, sizeof(uint8_t));
+    memset(one, 0xAB, 16);
+    ok &= (memory_live_count() == live + 1);
+    ok &= mem_new(NULL, &one, one, 100000, sizeof(uint8_t));
+    ok &= (memory_live_count() == live + 1);
+    ok &= mem_new_batch(NULL, ptr, 8, 32);
+    ok &= (memory_live_count() == live + 9);
+
+    if(ok){
+        printf("01 OK\n");
+    }else{
+        printf("ER\n");
+    }
+
+    ok &= memory_live_show(16);
+
+    /*Освобождение снимает блоки с учета*/
+    ok &= mem_del_batch(NULL, ptr, 8);
+    ok &= mem_del(NULL, &one);
+    ok &= (memory_live_count() == live);
+
+    if(ok){
+        printf("02 OK\n");
+    }else{
+        printf("ER\n");
+    }
+
+    /*Сверх таблицы блоки считаются потерянными, после освобождения и оборота таблица снова принимает все*/
+    const size_t count_many = YAYA_MEMORY_LIVE_COUNT + 1000;
+    void **many = malloc(count_many * sizeof(void*));
+    size_t lost = memory_live_dropped();
+    ok &= (many != NULL) && mem_new_batch(NULL, many, count_many, 8);
+    ok &= (memory_live_dropped() == lost + live + 1000) && (memory_live_count() == YAYA_MEMORY_LIVE_COUNT);
+    ok &= mem_del_batch(NULL, many, count_many);
+    ok &= (memory_live_count() == live);
+    lost = memory_live_dropped();
+    for(size_t i = 0; i < 4 * YAYA_MEMORY_LIVE_COUNT; i++){
+        ok &= mem_new(NULL, &one, NULL, i % 64 + 1, sizeof(uint8_t));
+        ok &= mem_new(NULL, &ptr[i % 8], ptr[i % 8], i % 200 + 1, sizeof(uint8_t));
+        ok &= mem_del(NULL, &one);
+    }
+    ok &= (memory_live_count() == live + 8) && (memory_live_dropped() == lost);
+    ok &= mem_del_batch(NULL, ptr, 8);
+    free(many);
+
+    if(ok){
+        printf("03 OK\n");
+    }else{
+        printf("ER\n");
+    }
+#endif
+
+    printf("\n");
+    fflush(stdout);
+}
+
+void test_check() {
+    printf("test_check\n");
+
+#if YAYA_MEMORY_CHECK_USE && YAYA_MEMORY_MACRO_DEF && YAYA_MEMORY_STATS_USE
+    uint8_t *ptr = NULL;
+    bool ok = true;
+
+    /*Запись за запрошенное портит хвост*/
+    ok &= mem_new(NULL, &ptr, NULL, 100, sizeof(uint8_t));
+    ok &= memory_check(ptr);
+    ptr[100] = 0x00;
+    ok &= !memory_check(ptr);
+    ptr[100] = YAYA_MEMORY_VALUE_AFTER_MEM;
+    ok &= memory_check(ptr);
+
+    if(ok){
+        printf("01 OK\n");
+    }else{
+        printf("ER\n");
+    }
+
+#if YAYA_MEMORY_LIVE_USE
+    /*Обход всех живых блоков*/
+    ok &= (memory_check_all() == 0);
+    ptr[101] = 0x00;
+    ok &= (memory_check_all() == 1);
+    ptr[101] = YAYA_MEMORY_VALUE_AFTER_MEM;
+    ok &= (memory_check_all() == 0);
+#endif
+    ok &= mem_del(NULL, &ptr);
+
+    if(ok){
+        printf("02 OK\n");
+    }else{
+        printf("ER\n");
+    }
+
+#if YAYA_MEMORY_CHECK_GUARD
+    /*Конец большого блока у страницы защиты, рост переносит блок*/
+    const size_t big = 1310720 + 8;
+    ok &= mem_new(NULL, &ptr, NULL, big, sizeof(uint8_t));
+    ok &= (((uintptr_t)(ptr + big) + 15) % 4096 < 16) && memory_check(ptr);
+    ptr[big - 1] = 0x11;
+    ok &= mem_new(NULL, &ptr, ptr, big + 4000, sizeof(uint8_t));
+    ok &= (ptr[big - 1] == 0x11) && (ptr[big] == 0x00) && memory_check(ptr);
+    ok &= (((uintptr_t)(ptr + big + 4000) + 15) % 4096 < 16);
+    ok &= mem_del(NULL, &ptr);
+#endif
+
+    if(ok){
+        printf("03 OK\n");
+    }else{
+        printf("ER\n");
+    }
+#endif
+
+    printf("\n");
+    fflush(stdout);
+}
+
+void test_quarantine() {
+    printf("test_quarantine\n");
+
+#if YAYA_MEMORY_QUARANTINE_USE && YAYA_MEMORY_MACRO_DEF && YAYA_MEMORY_STATS_USE
+    uint8_t *ptr = NULL;
+    uint8_t *old = NULL;
+    bool ok = true;
+
+    /*Освобожденный блок не выдается снова, пока стоит в очереди*/
+    ok &= memory_quarantine_flush();
+    ok &= mem_new(NULL, &ptr, NULL, 64, sizeof(uint8_t));
+    old = ptr;
+    ok &= mem_del(NULL, &ptr);
+    ok &= mem_new(NULL, &ptr, NULL, 64, sizeof(uint8_t));
+    ok &= (ptr != old);
+    ok &= mem_del(NULL, &ptr);
+
+    if(ok){
+        printf("01 OK\n");
+    }else{
+        printf("ER\n");
+    }
+
+    /*Запись в освобожденный блок находится при выходе из очереди*/
+    old[8] = 0x11;
+    ok &= !memory_quarantine_flush();
+    ok &= memory_quarantine_flush();
+
+    if(ok){
+        printf("02 OK\n");
+    }else{
+        printf("ER\n");
+    }
+
+    /*Очередь ограничена по объему, старые блоки вытесняются без ошибок*/
+    uint8_t *ptrs[64] = {0};
+    for(size_t r = 0; r < 8; r++){
+        ok &= mem_new_batch(NULL, ptrs, 64, 4096);
+        ok &= mem_del_batch(NULL, ptrs, 64);
+    }
+    ok &= memory_quarantine_flush();
+
+    if(ok){
+        printf("03 OK\n");
+    }else{
+        printf("ER\n");
+    }
+#endif
+
+    printf("\n");
+    fflush(stdout);
+}
+
+#if YAYA_MEMORY_TAG_USE
+static size_t test_tag_soft = 0;
+
+static void test_tag_callback(size_t tag, size_t live, size_t request)
+{
+    (void)(tag);
+    (void)(request);
+    test_tag_soft = live;
+}
+#endif
+
+void test_tag() {
+    printf("test_tag\n");
+
+#if YAYA_MEMORY_TAG_USE && YAYA_MEMORY_MACRO_DEF && YAYA_MEMORY_STATS_USE
+    uint8_t *ptr[4] = {0};
+    uint8_t *other = NULL;
+    mem_tag_t info = {0};
+    bool ok = true;
+
+    /*Блоки учитываются по тегу потока на момент выделения*/
+    ok &= (memory_tag_set(7) == 0);
+    ok &= mem_new(NULL, &ptr[0], NULL, 1000, sizeof(uint8_t));
+    ok &= mem_new_batch(NULL, &ptr[1], 2, 100);
+    ok &= (memory_tag_set(0) == 7);
+    ok &= mem_new(NULL, &other, NULL, 5000, sizeof(uint8_t));
+    ok &= memory_tag_get(7, &info) && (info.memory_live == 1200) && (info.memory_call == 2);
+
+    /*Рост учитывается по тегу блока*/
+    ok &= mem_new(NULL, &ptr[0], ptr[0], 3000, sizeof(uint8_t));
+    ok &= memory_tag_get(7, &info) && (info.memory_live == 3200);
+    ok &= (memory_tag_set(YAYA_MEMORY_TAG_COUNT) == SIZE_MAX);
+
+    if(ok){
+        printf("01 OK\n");
+    }else{
+        printf("ER\n");
+    }
+
+    /*Мягкий бюджет вызывает обработчик, жесткий отказывает*/
+    ok &= memory_tag_budget(7, 4000, 5000, test_tag_callback);
+    memory_tag_set(7);
+    ok &= mem_new(NULL, &ptr[3], NULL, 1000, sizeof(uint8_t));
+    ok &= (test_tag_soft == 4200);
+    ok &= !mem_new(NULL, &ptr[3], ptr[3], 2000, sizeof(uint8_t));
+    ok &= !mem_new(NULL, &other, NULL, 1000, sizeof(uint8_t));
+    memory_tag_set(0);
+    ok &= memory_tag_get(7, &info) && (info.memory_live == 4200) && (info.memory_fail == 2);
+
+    if(ok){
+        printf("02 OK\n");
+    }else{
+        printf("ER\n");
+    }
+
+    /*Освобождение снимает байты с тега*/
+    ok &= mem_del_batch(NULL, &ptr[1], 2);
+    ok &= mem_del(NULL, &ptr[0]);
+    ok &= mem_del(NULL, &ptr[3]);
+    ok &= mem_del(NULL, &other);
+    ok &= memory_tag_get(7, &info) && (info.memory_live == 0);
+    ok &= memory_tag_budget(7, 0, 0, NULL);
+
+    if(ok){
+        printf("03 OK\n");
+    }else{
+        printf("ER\n");
+    }
+#endif
+
+    printf("\n");
+    fflush(stdout);
+}
+
+void test_stats_diff() {
+    printf("test_stats_diff\n");
+
+#if YAYA_MEMORY_STATS_USE && YAYA_MEMORY_MACRO_DEF
+    mem_stats_t* mem_stats = NULL;
+    if(!memory_stats_init(&mem_stats)){
+        return;
+    }
+
+    int8_t *mas = NULL;
+    uint8_t *tmp = NULL;
+    mem_stats_t begin = {0};
+    mem_stats_t end = {0};
+    mem_stats_t diff = {0};
+    bool ok = true;
+
+    ok &= mem_new(mem_stats, &mas, NULL, 256, sizeof(int8_t));
+    ok &= mem_reserve(mem_stats, &mas, 4096, sizeof(int8_t));
+
+    /*Горячий путь: рост в запасе, сортировка и поиск без выделений*/
+    ok &= memory_stats_mark(mem_stats);
+    ok &= memory_stats_snapshot(mem_stats, &begin);
+    for(size_t i = 256; i < 4096; i++){
+        ok &= mem_new(mem_stats, &mas, mas, i + 1, sizeof(int8_t));
+        mas[i] = (int8_t)(i * 7);
+    }
+    ok &= mem_sort(mas, 4096, sizeof(int8_t), comp);
+    ok &= memory_stats_snapshot(mem_stats, &end);
+    ok &= memory_stats_diff(&begin, &end, &diff);
+    ok &= (diff.memory_call_new == 0) && (diff.memory_call_del == 0) && (diff.memory_produce == 0);
+    ok &= (diff.memory_call_res == 4096 - 256) && (diff.memory_request == 4096 - 256) && (diff.memory_peak == 0);
+
+    if(ok){
+        printf("01 OK\n");
+    }else{
+        printf("ER\n");
+    }
+
+    /*Временный блок в области: вызовы, пик и возврат занятого*/
+    ok &= memory_stats_mark(mem_stats);
+    ok &= memory_stats_snapshot(mem_stats, &begin);
+    ok &= mem_new(mem_stats, &tmp, NULL, 100000, sizeof(uint8_t));
+    ok &= mem_del(mem_stats, &tmp);
+    ok &= memory_stats_snapshot(mem_stats, &end);
+    ok &= memory_stats_diff(&begin, &end, &diff);
+    ok &= (diff.memory_call_new == 1) && (diff.memory_call_del == 1) && (diff.memory_produce == diff.memory_release);
+    ok &= (diff.memory_peak >= 100000) && (diff.memory_hist_request[17] == 1) && (diff.memory_hist_live[17] == 0);
+
+    if(ok){
+        printf("02 OK\n");
+    }else{
+        printf("ER\n");
+    }
+
+    /*Снимок не сбрасывает пик области, следующая область начинается с memory_stats_mark*/
+    ok &= memory_stats_snapshot(mem_stats, &end);
+    ok &= memory_stats_diff(&begin, &end, &diff);
+    ok &= (diff.memory_peak >= 100000);
+    ok &= memory_stats_mark(mem_stats);
+    ok &= memory_stats_snapshot(mem_stats, &begin);
+    ok &= memory_stats_snapshot(mem_stats, &end);
+    ok &= memory_stats_diff(&begin, &end, &diff);
+    ok &= (diff.memory_call_new == 0) && (diff.memory_peak == 0);
+    ok &= mem_del(mem_stats, &mas);
+
+    if(ok){
+        printf("03 OK\n");
+    }else{
+        printf("ER\n");
+    }
+
+    memory_stats_free(&mem_stats);
+#endif
+
+    printf("\n");
+    fflush(stdout);
+}
+
+static int test_sort_i32_comp(const void *a, const void *b) {
+    int32_t x = *(const int32_t*)(a);
+    int32_t y = *(const int32_t*)(b);
+    return (x > y) - (x < y);
+}
+
+static int test_sort_f64_comp(const void *a, const void *b) {
+    double x = *(const double*)(a);
+    double y = *(const double*)(b);
+    return (x > y) - (x < y);
+}
+
+typedef struct test_sort_rec_t {
+    int64_t key;
+    uint64_t val;
+}test_sort_rec_t;
+
+static int test_sort_rec_comp(const void *a, const void *b) {
+    int64_t x = ((const test_sort_rec_t*)(a))->key;
+    int64_t y = ((const test_sort_rec_t*)(b))->key;
+    return (x > y) - (x < y);
+}
+
+/*Указатели в compare выровнены как элементы массива*/
+static size_t test_sort_misaligned = 0;
+
+static int test_sort_rec_align_comp(const void *a, const void *b) {
+    test_sort_misaligned += (size_t)((uintptr_t)(a) % alignof(test_sort_rec_t) != 0) + (size_t)((uintptr_t)(b) % alignof(test_sort_rec_t) != 0);
+    return test_sort_rec_comp(a, b);
+}
+
+static int test_sort_u64_bytes_comp(const void *a, const void *b) {
+    uint64_t x = 0;
+    uint64_t y = 0;
+    memcpy(&x, a, sizeof(uint64_t));
+    memcpy(&y, b, sizeof(uint64_t));
+    return (x > y) - (x < y);
+}
+
+/*Заполнение по шаблону: случайно, по возрастанию, по убыванию, мало различных, пила*/
+static int64_t test_sort_value(size_t pattern, size_t i, size_t count, uint64_t *seed) {
+    *seed = *seed * 6364136223846793005ULL + 1442695040888963407ULL;
+    switch(pattern){
+        case 0:  return (int64_t)(*seed >> 11) - (int64_t)(1ULL << 52);
+        case 1:  return (int64_t)(i);
+        case 2:  return (int64_t)(count - i);
+        case 3:  return (int64_t)((*seed >> 40) % 4);
+        default: return (int64_t)(i % 37);
+    }
+}
+
+void test_sort_typed() {
+    printf("test_sort_typed\n");
+
+#if YAYA_MEMORY_STATS_USE && YAYA_MEMORY_MACRO_DEF
+    const size_t count_size = 6;
+    const size_t size[6] = {1, 16, 17, 129, 1000, 100000};
+    int32_t *mas_i32 = NULL;
+    int32_t *ref_i32 = NULL;
+    double  *mas_f64 = NULL;
+    double  *ref_f64 = NULL;
+    test_sort_rec_t *rec = NULL;
+    uint64_t seed = 1;
+    bool ok = true;
+
+    ok &= mem_new(NULL, &mas_i32, NULL, size[count_size - 1], sizeof(int32_t));
+    ok &= mem_new(NULL, &ref_i32, NULL, size[count_size - 1], sizeof(int32_t));
+    ok &= mem_new(NULL, &mas_f64, NULL, size[count_size - 1], sizeof(double));
+    ok &= mem_new(NULL, &ref_f64, NULL, size[count_size - 1], sizeof(double));
+    ok &= mem_new(NULL, &rec, NULL, size[count_size - 1], sizeof(test_sort_rec_t));
+
+    /*Результат совпадает с qsort на всех шаблонах*/
+    for(size_t s = 0; s < count_size && ok; s++){
+        for(size_t pattern = 0; pattern < 5; pattern++){
+            for(size_t i = 0; i < size[s]; i++){
+                int64_t v = test_sort_value(pattern, i, size[s], &seed);
+                mas_i32[i] = ref_i32[i] = (int32_t)(v);
+                mas_f64[i] = ref_f64[i] = (double)(v) / 3.0;
+            }
+            qsort(ref_i32, size[s], sizeof(int32_t), test_sort_i32_comp);
+            qsort(ref_f64, size[s], sizeof(double), test_sort_f64_comp);
+            ok &= mem_sort_i32(mas_i32, size[s]);
+            ok &= mem_sort_f64(mas_f64, size[s]);
+            ok &= (memcmp(mas_i32, ref_i32, size[s] * sizeof(int32_t)) == 0);
+            ok &= (memcmp(mas_f64, ref_f64, size[s] * sizeof(double)) == 0);
+        }
+    }
+
+    if(ok){
+        printf("01 OK\n");
+    }else{
+        printf("ER\n");
+    }
+
+    /*Записи по 16 байт через функцию сравнения, данные не теряются*/
+    const size_t count_rec = size[count_size - 1];
+    uint64_t sum = 0;
+    for(size_t i = 0; i < count_rec; i++){
+        rec[i].key = test_sort_value(3, i, count_rec, &seed) - 2;
+        rec[i].val = i;
+        sum += i;
+    }
+    ok &= mem_sort(rec, count_rec, sizeof(test_sort_rec_t), test_sort_rec_align_comp);
+    for(size_t i = 0; i < count_rec; i++){
+        ok &= (i == 0 || rec[i - 1].key <= rec[i].key);
+        sum -= rec[i].val;
+    }
+    ok &= (sum == 0) && (test_sort_misaligned == 0);
+
+    /*Невыровненный массив сортируется через qsort*/
+    uint8_t bytes[1 + 64 * sizeof(uint64_t)] = {0};
+    for(size_t i = 0; i < 64; i++){
+        uint64_t v = (uint64_t)(test_sort_value(0, i, 64, &seed));
+        memcpy(bytes + 1 + i * sizeof(uint64_t), &v, sizeof(uint64_t));
+    }
+    ok &= mem_sort(bytes + 1, 64, sizeof(uint64_t), test_sort_u64_bytes_comp);
+    for(size_t i = 1; i < 64; i++){
+        ok &= (test_sort_u64_bytes_comp(bytes + 1 + (i - 1) * sizeof(uint64_t), bytes + 1 + i * sizeof(uint64_t)) <= 0);
+    }
+
+    /*Знаковые и беззнаковые узкие типы*/
+    int8_t  mas_i8[5]  = {3, -128, 127, 0, -1};
+    uint8_t mas_u8[5]  = {3, 255, 128, 0, 1};
+    ok &= mem_sort_i8(mas_i8, 5) && mem_sort_u8(mas_u8, 5);
+    ok &= (mas_i8[0] == -128) && (mas_i8[1] == -1) && (mas_i8[4] == 127);
+    ok &= (mas_u8[0] == 0) && (mas_u8[3] == 128) && (mas_u8[4] == 255);
+    ok &= !mem_sort_i32(NULL, 5) && !mem_sort_i32(mas_i32, 0);
+
+    if(ok){
+        printf("02 OK\n");
+    }else{
+        printf("ER\n");
+    }
+
+    mem_del(NULL, &mas_i32);
+    mem_del(NULL, &ref_i32);
+    mem_del(NULL, &mas_f64);
+    mem_del(NULL, &ref_f64);
+    mem_del(NULL, &rec);
+#endif
+
+    printf("\n");
+    fflush(stdout);
+}
+
+typedef struct test_radix_rec_t {
+    uint32_t idx;
+    int32_t  key;
+}test_radix_rec_t;
+
+static uint64_t test_radix_key(const void *elem) {
+    return (uint64_t)(((const test_radix_rec_t*)(elem))->idx % 1000);
+}
+
+void test_sort_radix() {
+    printf("test_sort_radix\n");
+
+#if YAYA_MEMORY_STATS_USE && YAYA_MEMORY_MACRO_DEF
+    mem_stats_t* mem_stats = NULL;
+    if(!memory_stats_init(&mem_stats)){
+        return;
+    }
+
+    const size_t count_rec = 100000;
+    test_radix_rec_t *rec = NULL;
+    double *mas = NULL;
+    uint64_t seed = 7;
+    bool ok = true;
+
+    ok &= mem_new(mem_stats, &rec, NULL, count_rec, sizeof(test_radix_rec_t));
+    ok &= mem_new(mem_stats, &mas, NULL, count_rec, sizeof(double));
+
+    /*Знаковый ключ со смещением, равные ключи сохраняют порядок*/
+    for(size_t pattern = 0; pattern < 5; pattern++){
+        for(size_t i = 0; i < count_rec; i++){
+            rec[i].idx = (uint32_t)(i);
+            rec[i].key = (int32_t)(test_sort_value(pattern, i, count_rec, &seed) >> ((pattern == 0) ? 21 : 0));
+            rec[i].key = (pattern == 3) ? rec[i].key - 2 : rec[i].key;
+        }
+        ok &= mem_sort_radix(mem_stats, rec, count_rec, sizeof(test_radix_rec_t), offsetof(test_radix_rec_t, key), sizeof(int32_t), MEMORY_KEY_INT);
+        for(size_t i = 1; i < count_rec; i++){
+            ok &= (rec[i - 1].key < rec[i].key) || (rec[i - 1].key == rec[i].key && rec[i - 1].idx < rec[i].idx);
+        }
+    }
+
+    if(ok){
+        printf("01 OK\n");
+    }else{
+        printf("ER\n");
+    }
+
+    /*Числа с плавающей точкой с бесконечностями и нулями обоих знаков*/
+    for(size_t i = 0; i < count_rec; i++){
+        mas[i] = (double)(test_sort_value(0, i, count_rec, &seed)) * 1e-300;
+    }
+    mas[0] = -1.0 / 0.0;
+    mas[1] = +1.0 / 0.0;
+    mas[2] = -0.0;
+    mas[3] = +0.0;
+    mas[4] = -1e-310;
+    ok &= mem_sort_radix(mem_stats, mas, count_rec, sizeof(double), 0, sizeof(double), MEMORY_KEY_FLOAT);
+    for(size_t i = 1; i < count_rec; i++){
+        ok &= (mas[i - 1] <= mas[i]);
+    }
+    ok &= (mas[0] == -1.0 / 0.0) && (mas[count_rec - 1] == +1.0 / 0.0);
+
+    /*Ключ через функцию, буфер учтен в статистике*/
+    mem_stats_t begin = {0};
+    mem_stats_t end = {0};
+    mem_stats_t diff = {0};
+    memory_stats_mark(mem_stats);
+    memory_stats_snapshot(mem_stats, &begin);
+    ok &= memory_sort_radix(mem_stats, rec, count_rec, sizeof(test_radix_rec_t), 0, 2, MEMORY_KEY_UINT, test_radix_key);
+    memory_stats_snapshot(mem_stats, &end);
+    memory_stats_diff(&begin, &end, &diff);
+    for(size_t i = 1; i < count_rec; i++){
+        ok &= (rec[i - 1].idx % 1000 <= rec[i].idx % 1000);
+    }
+    ok &= (diff.memory_call_new == 1) && (diff.memory_call_del == 1) && (diff.memory_peak >= count_rec * sizeof(test_radix_rec_t));
+
+    /*Ключ за пределами записи и неверная ширина*/
+    ok &= !mem_sort_radix(mem_stats, rec, count_rec, sizeof(test_radix_rec_t), 6, 4, MEMORY_KEY_UINT);
+    ok &= !mem_sort_radix(mem_stats, rec, count_rec, sizeof(test_radix_rec_t), 0, 3, MEMORY_KEY_UINT);
+    ok &= !mem_sort_radix(mem_stats, rec, count_rec, sizeof(test_radix_rec_t), 0, 2, MEMORY_KEY_FLOAT);
+
+    if(ok){
+        printf("02 OK\n");
+    }else{
+        printf("ER\n");
+    }
+
+    mem_del(mem_stats, &rec);
+    mem_del(mem_stats, &mas);
+    memory_stats_free(&mem_stats);
+#endif
+
+    printf("\n");
+    fflush(stdout);
+}
+
+#if YAYA_MEMORY_PARALLEL_USE && YAYA_MEMORY_MACRO_DEF && YAYA_MEMORY_STATS_USE
+/*Одновременные вызовы делят пул: занятый пул сортирует в вызывающем потоке*/
+static void *test_sort_parallel_thread(void *arg) {
+    int32_t *mas = arg;
+    for(size_t round = 0; round < 4; round++){
+        for(size_t i = 0; i < 100000; i++){
+            mas[i] = (int32_t)((i * 7919 + round) % 100003);
+        }
+        if(!mem_sort_parallel(mas, 100000, sizeof(int32_t), test_sort_i32_comp, 4)){
+            return arg;
+        }
+        for(size_t i = 1; i < 100000; i++){
+            if(mas[i - 1] > mas[i]){
+                return arg;
+            }
+        }
+    }
+    return NULL;
+}
+#endif
+
+void test_sort_parallel() {
+    printf("test_sort_parallel\n");
+
+#if YAYA_MEMORY_PARALLEL_USE && YAYA_MEMORY_MACRO_DEF && YAYA_MEMORY_STATS_USE
+    const size_t count_mas = 300000;
+    const size_t count_thread = 6;
+    const size_t thread[6] = {1, 2, 3, 4, 7, 0};
+    int32_t *mas = NULL;
+    int32_t *ref = NULL;
+    test_sort_rec_t *rec = NULL;
+    uint64_t seed = 11;
+    bool ok = true;
+
+    ok &= mem_new(NULL, &mas, NULL, count_mas, sizeof(int32_t));
+    ok &= mem_new(NULL, &ref, NULL, count_mas, sizeof(int32_t));
+    ok &= mem_new(NULL, &rec, NULL, count_mas, sizeof(test_sort_rec_t));
+
+    /*Совпадает с qsort при любом числе потоков*/
+    for(size_t t = 0; t < count_thread; t++){
+        for(size_t pattern = 0; pattern < 5; pattern++){
+            for(size_t i = 0; i < count_mas; i++){
+                mas[i] = ref[i] = (int32_t)(test_sort_value(pattern, i, count_mas, &seed) >> ((pattern == 0) ? 21 : 0));
+            }
+            qsort(ref, count_mas, sizeof(int32_t), test_sort_i32_comp);
+            ok &= mem_sort_parallel(mas, count_mas, sizeof(int32_t), test_sort_i32_comp, thread[t]);
+            ok &= (memcmp(mas, ref, count_mas * sizeof(int32_t)) == 0);
+        }
+    }
+
+    if(ok){
+        printf("01 OK\n");
+    }else{
+        printf("ER\n");
+    }
+
+    /*Записи по 16 байт, части разной длины*/
+    uint64_t sum = 0;
+    for(size_t i = 0; i < count_mas; i++){
+        rec[i].key = test_sort_value(0, i, count_mas, &seed);
+        rec[i].val = i;
+        sum += i;
+    }
+    ok &= mem_sort_parallel(rec, count_mas, sizeof(test_sort_rec_t), test_sort_rec_comp, 5);
+    for(size_t i = 0; i < count_mas; i++){
+        ok &= (i == 0 || rec[i - 1].key <= rec[i].key);
+        sum -= rec[i].val;
+    }
+    ok &= (sum == 0);
+
+    /*Малый массив и неверные аргументы*/
+    int32_t small[4] = {3, 1, 2, 0};
+    ok &= mem_sort_parallel(small, 4, sizeof(int32_t), test_sort_i32_comp, 8);
+    ok &= (small[0] == 0) && (small[3] == 3);
+    ok &= !mem_sort_parallel(small, 4, sizeof(int32_t), NULL, 8);
+    ok &= !mem_sort_parallel(NULL, 4, sizeof(int32_t), test_sort_i32_comp, 8);
+
+    if(ok){
+        printf("02 OK\n");
+    }else{
+        printf("ER\n");
+    }
+
+    pthread_t caller[4];
+    for(size_t t = 0; t < 4; t++){
+        pthread_create(&caller[t], NULL, test_sort_parallel_thread, (int32_t*)(rec) + t * 100000);
+    }
+    for(size_t t = 0; t < 4; t++){
+        void *res = NULL;
+        pthread_join(caller[t], &res);
+        ok &= (res == NULL);
+    }
+
+    if(ok){
+        printf("03 OK\n");
+    }else{
+        printf("ER\n");
+    }
+
+    mem_del(NULL, &mas);
+    mem_del(NULL, &ref);
+    mem_del(NULL, &rec);
+#endif
+
+    printf("\n");
+    fflush(stdout);
+}
+
+void test_shuf_uniform() {
+    printf("test_shuf_uniform\n");
+
+#if YAYA_MEMORY_MACRO_DEF
+    const size_t count_test = 240000;
+    size_t hist[24] = {0};
+    bool ok = true;
+
+    /*Все 24 перестановки четырех элементов равновероятны: хи-квадрат с 23 степенями свободы*/
+    for(size_t t = 0; t < count_test; t++){
+        uint8_t mas[4] = {0, 1, 2, 3};
+        ok &= mem_shuf(mas, 4, sizeof(uint8_t), (unsigned int)(t));
+        size_t code = 0;
+        for(size_t i = 0; i < 4; i++){
+            size_t less = 0;
+            for(size_t j = i + 1; j < 4; j++){
+                less += (mas[j] < mas[i]);
+            }
+            code = code * (4 - i) + less;
+        }
+        hist[code]++;
+    }
+    double chi = 0;
+    for(size_t p = 0; p < 24; p++){
+        double d = (double)(hist[p]) - (double)(count_test) / 24.0;
+        chi += d * d / ((double)(count_test) / 24.0);
+    }
+    ok &= (chi < 49.7);
+
+    if(ok){
+        printf("01 OK\n");
+    }else{
+        printf("ER\n");
+    }
+
+    /*Один seed - одна перестановка, элементы не теряются при любом размере*/
+    uint64_t a[1000];
+    uint64_t b[1000];
+    uint8_t  c[3 * 1000];
+    uint64_t sum = 0;
+    for(size_t i = 0; i < 1000; i++){
+        a[i] = b[i] = i;
+        c[3 * i] = (uint8_t)(i);
+        c[3 * i + 1] = (uint8_t)(i >> 8);
+        c[3 * i + 2] = 0;
+        sum += i;
+    }
+    ok &= mem_shuf(a, 1000, sizeof(uint64_t), 42) && mem_shuf(b, 1000, sizeof(uint64_t), 42);
+    ok &= (memcmp(a, b, sizeof(a)) == 0);
+    ok &= mem_shuf(b, 1000, sizeof(uint64_t), 43);
+    ok &= (memcmp(a, b, sizeof(a)) != 0);
+    ok &= mem_shuf(c, 1000, 3, 42);
+    for(size_t i = 0; i < 1000; i++){
+        sum -= (size_t)(c[3 * i]) | ((size_t)(c[3 * i + 1]) << 8);
+    }
+    ok &= (sum == 0);
+
+    /*Свой генератор как rand, без set_seed по-прежнему srand(seed)*/
+    ok &= memory_shuf(a, 1000, sizeof(uint64_t), 1, (mem_seed_fn_t)(srand), (mem_rand_fn_t)(rand));
+    srand(77);
+    ok &= memory_shuf(b, 1000, sizeof(uint64_t), 1, NULL, (mem_rand_fn_t)(rand));
+    ok &= (memcmp(a, b, sizeof(a)) != 0);
+    for(size_t i = 0; i < 1000; i++){
+        a[i] = b[i] = i;
+    }
+    ok &= memory_shuf(a, 1000, sizeof(uint64_t), 5, (mem_seed_fn_t)(srand), (mem_rand_fn_t)(rand));
+    srand(77);
+    ok &= memory_shuf(b, 1000, sizeof(uint64_t), 5, NULL, (mem_rand_fn_t)(rand));
+    ok &= (memcmp(a, b, sizeof(a)) == 0);
+
+    if(ok){
+        printf("02 OK\n");
+    }else{
+        printf("ER\n");
+    }
+#endif
+
+    printf("\n");
+    fflush(stdout);
+}
+
+void test_shuf_parallel() {
+    printf("test_shuf_parallel\n");
+
+#if YAYA_MEMORY_PARALLEL_USE && YAYA_MEMORY_MACRO_DEF && YAYA_MEMORY_STATS_USE
+    const size_t count_mas = 1U << 20;
+    uint32_t *mas = NULL;
+    uint32_t *ref = NULL;
+    bool ok = true;
+
+    ok &= mem_new(NULL, &mas, NULL, count_mas, sizeof(uint32_t));
+    ok &= mem_new(NULL, &ref, NULL, count_mas, sizeof(uint32_t));
+
+    /*Перемешивание между блоками: из какой шестнадцатой части в какую, хи-квадрат с 225 степенями свободы*/
+    for(size_t i = 0; i < count_mas; i++){
+        mas[i] = (uint32_t)(i);
+    }
+    ok &= mem_shuf_parallel(mas, count_mas, sizeof(uint32_t), 5, 3);
+    size_t cell[16][16] = {0};
+    for(size_t i = 0; i < count_mas; i++){
+        cell[mas[i] / (count_mas / 16)][i / (count_mas / 16)]++;
+    }
+    double chi = 0;
+    for(size_t a = 0; a < 16; a++){
+        for(size_t b = 0; b < 16; b++){
+            double d = (double)(cell[a][b]) - (double)(count_mas) / 256.0;
+            chi += d * d / ((double)(count_mas) / 256.0);
+        }
+    }
+    ok &= (chi < 310.0);
+
+    /*Все элементы на месте*/
+    memcpy(ref, mas, count_mas * sizeof(uint32_t));
+    ok &= mem_sort_u32(ref, count_mas);
+    for(size_t i = 0; i < count_mas; i++){
+        ok &= (ref[i] == i);
+    }
+
+    if(ok){
+        printf("01 OK\n");
+    }else{
+        printf("ER\n");
+    }
+
+    /*Один seed и число потоков - одна перестановка*/
+    for(size_t i = 0; i < count_mas; i++){
+        mas[i] = ref[i] = (uint32_t)(i);
+    }
+    ok &= mem_shuf_parallel(mas, count_mas, sizeof(uint32_t), 9, 4);
+    ok &= mem_shuf_parallel(ref, count_mas, sizeof(uint32_t), 9, 4);
+    ok &= (memcmp(mas, ref, count_mas * sizeof(uint32_t)) == 0);
+    ok &= mem_shuf_parallel(ref, count_mas, sizeof(uint32_t), 10, 4);
+    ok &= (memcmp(mas, ref, count_mas * sizeof(uint32_t)) != 0);
+    ok &= !mem_shuf_parallel(NULL, count_mas, sizeof(uint32_t), 9, 4);
+
+    if(ok){
+        printf("02 OK\n");
+    }else{
+        printf("ER\n");
+    }
+
+    /*Элемент не из особых размеров и один поток: все элементы целы, первый уходит куда угодно*/
+    typedef struct test_shuf_item_t {
+        uint32_t key;
+        uint32_t pad[2];
+    }test_shuf_item_t;
+    test_shuf_item_t *item = NULL;
+    ok &= mem_new(NULL, &item, NULL, count_mas, sizeof(test_shuf_item_t));
+    for(size_t i = 0; i < count_mas; i++){
+        item[i].key = (uint32_t)(i);
+        item[i].pad[0] = item[i].pad[1] = (uint32_t)(~i);
+    }
+    ok &= mem_shuf_parallel(item, count_mas, sizeof(test_shuf_item_t), 11, 1);
+    size_t half = 0;
+    for(size_t i = 0; i < count_mas; i++){
+        ok &= (item[i].pad[0] == ~item[i].key) && (item[i].pad[1] == ~item[i].key);
+        ref[i] = item[i].key;
+        half += (item[i].key < count_mas / 2) && (i < count_mas / 2);
+    }
+    ok &= mem_sort_u32(ref, count_mas);
+    for(size_t i = 0; i < count_mas; i++){
+        ok &= (ref[i] == i);
+    }
+    /*Из первой половины в первую половину около четверти, отклонение меньше шести сигм*/
+    ok &= (half > count_mas / 4 - 1536) && (half < count_mas / 4 + 1536);
+    mem_del(NULL, &item);
+
+    if(ok){
+        printf("03 OK\n");
+    }else{
+        printf("ER\n");
+    }
+
+    mem_del(NULL, &mas);
+    mem_del(NULL, &ref);
+#endif
+
+    printf("\n");
+    fflush(stdout);
+}
+
 int main()
 {
     test_param();
@@ -879,5 +2811,28 @@ int main()
     test_shuf();
     test_sort();
     test_search();
+    test_slab();
+    test_arena();
+    test_mmap();
+    test_huge();
+    test_reserve();
+    test_aligned();
+    test_batch();
+    test_stats();
+    test_hist();
+    test_site();
+    test_export();
+    test_sample();
+    test_latency();
+    test_live();
+    test_check();
+    test_quarantine();
+    test_tag();
+    test_stats_diff();
+    test_sort_typed();
+    test_sort_radix();
+    test_sort_parallel();
+    test_shuf_uniform();
+    test_shuf_parallel();
     return 0;
 }